@@ -0,0 +1,96 @@
+#ifndef _analyze_h
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.h"
+
+namespace bigdumb{
+    int xboard_score(int score){
+        // xboard reads a mate as 100000 plus the moves to it
+        int plies=mate_in(score);
+        if(plies<0) return score;
+        return score>0 ? 100000+(plies+1)/2 : -100000-(plies+1)/2;
+    }
+
+    void analyse(Board board, int multipv, std::function<void(const std::string &)> reply){
+        // deepens until told to stop, printing the best `multipv` root
+        // moves after each iteration in xboard's thinking format. each
+        // line searches with the ones above it left out, and the table
+        // the earlier lines filled makes that cheap.
+        std::shared_ptr<SearchContext> context=board.context;
+        context->stats.clear();
+        // the search is pseudo-legal, so moves into check are left out
+        // from the start rather than reported as lines
+        std::vector<ChessMove> illegal;
+        int legal=0;
+        Board temp_board=board;
+        temp_board.gen_moves();
+        std::list<ChessMove> moves=temp_board.capture;
+        moves.insert(moves.end(), temp_board.quiet.begin(), temp_board.quiet.end());
+        for(std::list<ChessMove>::iterator i=moves.begin(); i!=moves.end(); i++){
+            if(board.legal((*i).from, (*i).to)) legal++;
+            else illegal.push_back(*i);
+        }
+        int lines=multipv<legal ? multipv : legal;
+        bool white=board.half_move%2==0;
+        std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+        // a single line stops once it has proven a mate within the depth
+        int proven=-1;
+        for(int depth=1; depth<MAX_PLY && lines>0 && !context->stop && !(lines==1 && proven>=0 && proven<depth); depth++){
+            context->excluded=illegal;
+            context->excluded_legal=0;
+            for(int line=0; line<lines; line++){
+                int score=board.search(depth);
+                if(context->stop || context->best.from<0) break;
+                long long cs=std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now()-start).count()/10;
+                // xboard wants the score for the side to move
+                std::ostringstream out;
+                out << depth << " " << xboard_score(white ? score : -score) << " " << cs << " "
+                    << context->stats.nodes << " " << board.pv(depth);
+                reply(out.str());
+                context->excluded.push_back(context->best);
+                context->excluded_legal++;
+                proven=mate_in(score);
+            }
+            LOG_DEBUG("analysed to depth " << depth << ", " << context->stats.nodes << " nodes");
+        }
+        context->excluded.clear();
+        context->excluded_legal=0;
+    }
+
+    // runs analyse() on its own thread so the xboard loop can keep
+    // reading commands
+    class Analysis{
+        public:
+            std::thread worker;
+            std::shared_ptr<SearchContext> context;
+
+            bool running(){
+                return worker.joinable();
+            }
+
+            void start(const Board &board, int multipv, std::function<void(const std::string &)> reply){
+                stop();
+                context=board.context;
+                context->stop=false;
+                worker=std::thread(analyse, board, multipv, reply);
+            }
+
+            void stop(){
+                if(!worker.joinable()) return;
+                context->stop=true;
+                worker.join();
+                context->stop=false;
+            }
+    };
+}
+
+#define _analyze_h
+#endif
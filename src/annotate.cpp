@@ -0,0 +1,316 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <list>
+#include <string>
+#include "debug.h"
+#include "movestore.h"
+#include "board.h"
+#include "mapfile.h"
+#include "pgn.h"
+
+// annotates games with the engine's evaluation of every move:
+//
+//   annotate [-threads N] [-depth N | -nodes N] [-mistake cp] [-blunder cp]
+//            [-hash mb] [-batch N] [-out file] games.pgn ...
+//
+// the files are mapped and split into games in place, and the
+// positions of -batch games at a time are shared out to the threads,
+// each searched to -depth, or deepened until it has used -nodes. the
+// games come out in the order they went in, every move followed by a
+// {score/depth} comment: the position after it from white's side, in
+// pawns. a move that gives away -mistake centipawns or more of what the
+// position before it was worth is marked ?, and -blunder or more ??.
+// comments, variations and NAGs already in the games are dropped.
+
+using namespace std;
+
+class Annotated{
+    public:
+        bigdumb::PgnSpan span;
+        bigdumb::PgnGame game;
+        // the moves up to the first one that doesn't resolve
+        vector<string> coords;
+        // score and depth of each position, start to end of coords;
+        // empty when the game can't be set up at all
+        vector<int> score;
+        vector<int> depth;
+};
+
+class Settings{
+    public:
+        int depth;
+        long long nodes;
+        int mistake;
+        int blunder;
+};
+
+void analyse(Annotated &g, size_t ply, const Settings &s){
+    // each job replays its game on a board of its own, so threads share
+    // nothing but the table, and repetitions before the position count
+    bigdumb::Board board;
+    board.set_fen(g.game.start_fen());
+    for(size_t i=0; i<ply; i++) board.move(g.coords[i]);
+    bool white=board.half_move%2==0;
+    if(board.legal_moves().empty()){
+        g.score[ply]=board.in_check(white) ? (white ? -MATE_BOUND : MATE_BOUND) : 0;
+        g.depth[ply]=0;
+        return;
+    }
+    // is_draw() takes one repetition for a draw, which is right inside
+    // the search but not for a position the game actually reached
+    if(board.fifty_clock>=100){
+        g.score[ply]=0;
+        g.depth[ply]=0;
+        return;
+    }
+    if(!s.nodes){
+        g.score[ply]=board.search(s.depth);
+        g.depth[ply]=s.depth;
+        return;
+    }
+    // the last iteration that finished inside the budget
+    int score=board.search(1), reached=1;
+    board.context->node_limit=s.nodes;
+    for(int d=2; d<=s.depth && d<MAX_PLY; d++){
+        int x=board.search(d);
+        if(board.context->stop) break;
+        score=x;
+        reached=d;
+    }
+    g.score[ply]=score;
+    g.depth[ply]=reached;
+}
+
+int clamp(int score){
+    // a mate is just a lot, so it compares like any other score
+    if(score>MATE_BOUND) return MATE_BOUND;
+    if(score<-MATE_BOUND) return -MATE_BOUND;
+    return score;
+}
+
+string comment(int score, int depth){
+    ostringstream out;
+    out << "{";
+    // a mate the search found, in moves; a position that is mate already
+    // is just a mate
+    int plies=bigdumb::mate_in(score);
+    if(plies>0) out << (score>0 ? "+M" : "-M") << (plies+1)/2;
+    else if(score>=MATE_BOUND) out << "+mate";
+    else if(score<=-MATE_BOUND) out << "-mate";
+    else{
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%+.2f", score/100.0);
+        out << buf;
+    }
+    if(depth) out << "/" << depth;
+    out << "}";
+    return out.str();
+}
+
+string plain(string san){
+    // the move without whatever !? marks it came with
+    while(!san.empty() && (san[san.length()-1]=='!' || san[san.length()-1]=='?')) san.erase(san.length()-1);
+    return san;
+}
+
+class Writer{
+    // movetext wrapped at 80 columns, as PGN export format wants
+    public:
+        ostream &out;
+        size_t column;
+
+        Writer(ostream &o) : out(o){
+            column=0;
+        }
+
+        void word(const string &w){
+            if(column && column+1+w.length()>79){
+                out << "\n";
+                column=0;
+            }
+            if(column){
+                out << " ";
+                column++;
+            }
+            out << w;
+            column+=w.length();
+        }
+
+        void end(){
+            out << "\n\n";
+            column=0;
+        }
+};
+
+void write_game(ostream &out, const Annotated &g, const Settings &s, const string &annotator){
+    // the tag section as it was, plus who annotated it
+    const char *line=g.span.tags;
+    while(line<g.span.movetext){
+        const char *eol=static_cast<const char *>(memchr(line, '\n', g.span.movetext-line));
+        const char *next_line=eol ? eol+1 : g.span.movetext;
+        const char *last=next_line;
+        while(last>line && isspace(static_cast<unsigned char>(last[-1]))) last--;
+        if(last>line) out << string(line, last) << "\n";
+        line=next_line;
+    }
+    if(!g.game.tags.count("Annotator")) out << "[Annotator \"" << annotator << "\"]\n";
+    out << "\n";
+
+    Writer w(out);
+    bigdumb::Board start;
+    start.set_fen(g.game.start_fen());
+    int half_move=start.half_move;
+    bool after_comment=true;
+    for(size_t m=0; m<g.game.moves.size(); m++, half_move++){
+        bool white=half_move%2==0;
+        ostringstream number;
+        number << half_move/2+1 << (white ? "." : "...");
+        if(white || after_comment) w.word(number.str());
+        if(m>=g.coords.size()){
+            // past a move that didn't resolve: as it came
+            w.word(g.game.moves[m]);
+            after_comment=false;
+            continue;
+        }
+        int before=clamp(g.score[m]), after=clamp(g.score[m+1]);
+        int loss=white ? before-after : after-before;
+        string san=plain(g.game.moves[m]);
+        if(loss>=s.blunder) san+="??";
+        else if(loss>=s.mistake) san+="?";
+        w.word(san);
+        w.word(comment(g.score[m+1], g.depth[m+1]));
+        after_comment=true;
+    }
+    w.word(g.game.result);
+    w.end();
+}
+
+int main(int argc, char **argv){
+    int threads=thread::hardware_concurrency();
+    int batch=256, hash=TT_MB;
+    Settings s;
+    s.depth=ROOT_DEPTH;
+    s.nodes=0;
+    s.mistake=100;
+    s.blunder=300;
+    string out_file;
+    vector<string> files;
+    for(int i=1; i<argc; i++){
+        string opt=argv[i];
+        if(opt[0]!='-'){
+            files.push_back(opt);
+            continue;
+        }
+        if(i+1>=argc){
+            cerr << "option " << opt << " needs a value\n";
+            return 1;
+        }
+        string val=argv[++i];
+        if(opt=="-threads") threads=atoi(val.c_str());
+        else if(opt=="-depth") s.depth=atoi(val.c_str());
+        else if(opt=="-nodes") s.nodes=atoll(val.c_str());
+        else if(opt=="-mistake") s.mistake=atoi(val.c_str());
+        else if(opt=="-blunder") s.blunder=atoi(val.c_str());
+        else if(opt=="-hash") hash=atoi(val.c_str());
+        else if(opt=="-batch") batch=atoi(val.c_str());
+        else if(opt=="-out") out_file=val;
+        else{
+            cerr << "unknown option " << opt << "\n";
+            return 1;
+        }
+    }
+    if(files.empty()){
+        cerr << "usage: annotate [-threads N] [-depth N | -nodes N] [-mistake cp] [-blunder cp]\n"
+             << "                [-hash mb] [-batch N] [-out file] games.pgn ...\n";
+        return 1;
+    }
+    if(threads<1) threads=1;
+    if(batch<1) batch=1;
+    // with a node budget, -depth only caps how far it deepens
+    if(s.nodes && s.depth==ROOT_DEPTH) s.depth=MAX_PLY-1;
+    if(s.depth<1) s.depth=1;
+    precomputeAll();
+    bigdumb::TT.resize(hash);
+
+    ostringstream who;
+    who << "tal " << (s.nodes ? "nodes " : "depth ");
+    if(s.nodes) who << s.nodes;
+    else who << s.depth;
+    string annotator=who.str();
+
+    ofstream file;
+    if(!out_file.empty()) file.open(out_file.c_str(), ios::binary);
+    ostream &out=out_file.empty() ? cout : file;
+
+    long long games=0, positions=0, broken=0;
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    for(size_t f=0; f<files.size(); f++){
+        bigdumb::MappedFile mapped;
+        if(!mapped.open(files[f].c_str())){
+            cerr << "error: can't open " << files[f] << "\n";
+            continue;
+        }
+        const char *text=reinterpret_cast<const char *>(mapped.data);
+        bigdumb::PgnReader reader(text, text+mapped.size);
+        vector<Annotated> pending;
+        bool more=true;
+        while(more){
+            // a batch of games and the list of their positions
+            pending.clear();
+            bigdumb::PgnSpan span;
+            while(static_cast<int>(pending.size())<batch && (more=reader.next(span))){
+                pending.push_back(Annotated());
+                Annotated &g=pending.back();
+                g.span=span;
+                bigdumb::parse_pgn_game(span, g.game);
+                bigdumb::Board board;
+                if(!board.set_fen(g.game.start_fen())){
+                    cerr << "warning: game " << games+pending.size() << " has a bad FEN, left as it is\n";
+                    broken++;
+                    continue;
+                }
+                for(size_t m=0; m<g.game.moves.size(); m++){
+                    string coord;
+                    if(!bigdumb::resolve_san(board, g.game.moves[m], coord)){
+                        cerr << "warning: game " << games+pending.size() << ": can't play "
+                             << g.game.moves[m] << ", annotating the moves before it\n";
+                        broken++;
+                        break;
+                    }
+                    board.move(coord);
+                    g.coords.push_back(coord);
+                }
+                g.score.assign(g.coords.size()+1, 0);
+                g.depth.assign(g.coords.size()+1, 0);
+            }
+            vector<pair<int, int> > jobs;
+            for(size_t i=0; i<pending.size(); i++)
+                for(size_t p=0; p<pending[i].score.size(); p++) jobs.push_back(make_pair(i, p));
+            atomic<size_t> next(0);
+            vector<thread> pool;
+            for(int t=0; t<threads; t++){
+                pool.push_back(thread([&](){
+                    for(size_t j=next++; j<jobs.size(); j=next++) analyse(pending[jobs[j].first], jobs[j].second, s);
+                }));
+            }
+            for(size_t t=0; t<pool.size(); t++) pool[t].join();
+            for(size_t i=0; i<pending.size(); i++) write_game(out, pending[i], s, annotator);
+            out.flush();
+            games+=pending.size();
+            positions+=jobs.size();
+            double elapsed=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+            fprintf(stderr, "%lld games, %lld positions, %.1f positions/s\n",
+                    games, positions, elapsed>0 ? positions/elapsed : 0.0);
+        }
+    }
+    if(broken) cerr << broken << " games couldn't be played to the end\n";
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef _attacks_h
+
+#include <bitset>
+
+// everything the pieces of a position attack, worked out once per node
+// and kept on the Board: move generation reads the slider sets from it,
+// check detection the side totals, and quiescence the defenders.
+// attacks are squares a piece could capture on, so pawn pushes aren't
+// in here, and sliders stop at (and include) the first piece they hit.
+
+#define SIDE_WHITE 0
+#define SIDE_BLACK 1
+
+namespace bigdumb{
+    class AttackInfo{
+        public:
+            // what the piece standing on each square attacks
+            std::bitset<64> piece[64];
+            // by side, and by side and piece type (P N B R Q K)
+            std::bitset<64> all[2];
+            std::bitset<64> by_type[2][6];
+            // squares a side hits with two pieces or more
+            std::bitset<64> twice[2];
+            // king squares, -1 when the king has been taken
+            int king[2];
+            // where each side's men and pawns stand
+            std::bitset<64> men[2];
+            std::bitset<64> pawns[2];
+
+            void compute(const char a[8][8]){
+                std::bitset<64> occupied;
+                for(int sq=0; sq<64; sq++) if(a[sq>>3][sq&7]!='.') occupied.set(sq);
+                for(int side=0; side<2; side++){
+                    all[side].reset();
+                    twice[side].reset();
+                    for(int t=0; t<6; t++) by_type[side][t].reset();
+                    king[side]=-1;
+                    men[side].reset();
+                    pawns[side].reset();
+                }
+                for(int sq=0; sq<64; sq++){
+                    char p=a[sq>>3][sq&7];
+                    std::bitset<64> &s=piece[sq];
+                    int t;
+                    switch(p){
+                        case 'P': s=WHITEPAWNFORK[sq]; t=0; break;
+                        case 'p': s=BLACKPAWNFORK[sq]; t=0; break;
+                        case 'N': case 'n': s=N[sq]; t=1; break;
+                        case 'B': case 'b': s=bishop_attacks(sq, occupied); t=2; break;
+                        case 'R': case 'r': s=rook_attacks(sq, occupied); t=3; break;
+                        case 'Q': case 'q': s=bishop_attacks(sq, occupied) | rook_attacks(sq, occupied); t=4; break;
+                        case 'K': case 'k': s=K[sq]; t=5; break;
+                        default: s.reset(); continue;
+                    }
+                    int side=(p>='A' && p<='Z') ? SIDE_WHITE : SIDE_BLACK;
+                    if(t==5) king[side]=sq;
+                    if(t==0) pawns[side].set(sq);
+                    men[side].set(sq);
+                    by_type[side][t]|=s;
+                    twice[side]|=all[side] & s;
+                    all[side]|=s;
+                }
+            }
+    };
+}
+
+#define _attacks_h
+#endif
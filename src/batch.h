@@ -0,0 +1,326 @@
+#ifndef _batch_h
+
+#include <stdint.h>
+#include <bitset>
+#include "board.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// many unrelated positions at once, for offline work that has millions
+// of them (data generation, batch analysis): attack sets, move counts,
+// and material with piece squares, for BATCH_LANES positions in the
+// lanes of one vector.
+//
+// positions are stored structure of arrays, one 64 bit bitboard per
+// side and piece type with a lane per position, and sliders are filled
+// with Kogge-Stone shifts rather than table lookups, so every lane does
+// the same work. -mavx512f builds get 8 lanes, -mavx2 builds 4, and
+// without either the same code runs on plain integers, 4 at a time, and
+// gives the same answers.
+//
+// squares are the board's: bit 0 is a8, bit 63 h1, white moves towards
+// bit 0. types are P N B R Q K, as in AttackInfo.
+
+namespace bigdumb{
+#if defined(__AVX512F__)
+#define BATCH_LANES 8
+    typedef __m512i BatchVec;
+
+    inline BatchVec bv_load(const uint64_t *p){ return _mm512_loadu_si512(p); }
+    inline void bv_store(uint64_t *p, BatchVec v){ _mm512_storeu_si512(p, v); }
+    inline BatchVec bv_set1(uint64_t x){ return _mm512_set1_epi64(static_cast<long long>(x)); }
+    inline BatchVec bv_zero(){ return _mm512_setzero_si512(); }
+    inline BatchVec bv_and(BatchVec a, BatchVec b){ return _mm512_and_si512(a, b); }
+    inline BatchVec bv_or(BatchVec a, BatchVec b){ return _mm512_or_si512(a, b); }
+    // a and not b
+    inline BatchVec bv_andnot(BatchVec a, BatchVec b){ return _mm512_andnot_si512(b, a); }
+    inline BatchVec bv_add(BatchVec a, BatchVec b){ return _mm512_add_epi64(a, b); }
+    inline BatchVec bv_sub(BatchVec a, BatchVec b){ return _mm512_sub_epi64(a, b); }
+    // low 32 bits of each lane times a constant
+    inline BatchVec bv_mul(BatchVec a, uint32_t k){ return _mm512_mul_epu32(a, _mm512_set1_epi64(k)); }
+    template<int N> inline BatchVec bv_shl(BatchVec v){ return _mm512_slli_epi64(v, N); }
+    template<int N> inline BatchVec bv_shr(BatchVec v){ return _mm512_srli_epi64(v, N); }
+
+    inline BatchVec bv_popcount(BatchVec v){
+#if defined(__AVX512VPOPCNTDQ__)
+        return _mm512_popcnt_epi64(v);
+#elif defined(__AVX512BW__)
+        // four bit table lookups, summed per lane
+        const __m512i lut=_mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+        const __m512i low=_mm512_set1_epi8(0x0F);
+        __m512i n=_mm512_add_epi8(_mm512_shuffle_epi8(lut, _mm512_and_si512(v, low)),
+                                  _mm512_shuffle_epi8(lut, _mm512_and_si512(_mm512_srli_epi64(v, 4), low)));
+        return _mm512_sad_epu8(n, _mm512_setzero_si512());
+#else
+        // AVX2's version on each half
+        const __m256i lut=_mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low=_mm256_set1_epi8(0x0F);
+        __m256i half[2]={_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1)};
+        for(int i=0; i<2; i++){
+            __m256i n=_mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(half[i], low)),
+                                      _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi64(half[i], 4), low)));
+            half[i]=_mm256_sad_epu8(n, _mm256_setzero_si256());
+        }
+        return _mm512_inserti64x4(_mm512_castsi256_si512(half[0]), half[1], 1);
+#endif
+    }
+#elif defined(__AVX2__)
+#define BATCH_LANES 4
+    typedef __m256i BatchVec;
+
+    inline BatchVec bv_load(const uint64_t *p){ return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    inline void bv_store(uint64_t *p, BatchVec v){ _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    inline BatchVec bv_set1(uint64_t x){ return _mm256_set1_epi64x(static_cast<long long>(x)); }
+    inline BatchVec bv_zero(){ return _mm256_setzero_si256(); }
+    inline BatchVec bv_and(BatchVec a, BatchVec b){ return _mm256_and_si256(a, b); }
+    inline BatchVec bv_or(BatchVec a, BatchVec b){ return _mm256_or_si256(a, b); }
+    inline BatchVec bv_andnot(BatchVec a, BatchVec b){ return _mm256_andnot_si256(b, a); }
+    inline BatchVec bv_add(BatchVec a, BatchVec b){ return _mm256_add_epi64(a, b); }
+    inline BatchVec bv_sub(BatchVec a, BatchVec b){ return _mm256_sub_epi64(a, b); }
+    inline BatchVec bv_mul(BatchVec a, uint32_t k){ return _mm256_mul_epu32(a, _mm256_set1_epi64x(k)); }
+    template<int N> inline BatchVec bv_shl(BatchVec v){ return _mm256_slli_epi64(v, N); }
+    template<int N> inline BatchVec bv_shr(BatchVec v){ return _mm256_srli_epi64(v, N); }
+
+    inline BatchVec bv_popcount(BatchVec v){
+        const __m256i lut=_mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low=_mm256_set1_epi8(0x0F);
+        __m256i n=_mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+                                  _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi64(v, 4), low)));
+        return _mm256_sad_epu8(n, _mm256_setzero_si256());
+    }
+#else
+#define BATCH_LANES 4
+    class BatchVec{
+        public:
+            uint64_t v[BATCH_LANES];
+    };
+
+    inline BatchVec bv_load(const uint64_t *p){ BatchVec r; for(int i=0; i<BATCH_LANES; i++) r.v[i]=p[i]; return r; }
+    inline void bv_store(uint64_t *p, BatchVec v){ for(int i=0; i<BATCH_LANES; i++) p[i]=v.v[i]; }
+    inline BatchVec bv_set1(uint64_t x){ BatchVec r; for(int i=0; i<BATCH_LANES; i++) r.v[i]=x; return r; }
+    inline BatchVec bv_zero(){ return bv_set1(0); }
+    inline BatchVec bv_and(BatchVec a, BatchVec b){ for(int i=0; i<BATCH_LANES; i++) a.v[i]&=b.v[i]; return a; }
+    inline BatchVec bv_or(BatchVec a, BatchVec b){ for(int i=0; i<BATCH_LANES; i++) a.v[i]|=b.v[i]; return a; }
+    inline BatchVec bv_andnot(BatchVec a, BatchVec b){ for(int i=0; i<BATCH_LANES; i++) a.v[i]&=~b.v[i]; return a; }
+    inline BatchVec bv_add(BatchVec a, BatchVec b){ for(int i=0; i<BATCH_LANES; i++) a.v[i]+=b.v[i]; return a; }
+    inline BatchVec bv_sub(BatchVec a, BatchVec b){ for(int i=0; i<BATCH_LANES; i++) a.v[i]-=b.v[i]; return a; }
+    inline BatchVec bv_mul(BatchVec a, uint32_t k){ for(int i=0; i<BATCH_LANES; i++) a.v[i]=(a.v[i]&0xFFFFFFFF)*k; return a; }
+    template<int N> inline BatchVec bv_shl(BatchVec a){ for(int i=0; i<BATCH_LANES; i++) a.v[i]<<=N; return a; }
+    template<int N> inline BatchVec bv_shr(BatchVec a){ for(int i=0; i<BATCH_LANES; i++) a.v[i]>>=N; return a; }
+    inline BatchVec bv_popcount(BatchVec a){ for(int i=0; i<BATCH_LANES; i++) a.v[i]=std::bitset<64>(a.v[i]).count(); return a; }
+#endif
+
+    const uint64_t BATCH_FILE_A=0x0101010101010101ULL;
+    const uint64_t BATCH_FILE_B=BATCH_FILE_A<<1;
+    const uint64_t BATCH_FILE_G=BATCH_FILE_A<<6;
+    const uint64_t BATCH_FILE_H=BATCH_FILE_A<<7;
+
+    constexpr uint64_t batch_wrap(int dx){
+        // what a step dx files sideways may land on without having
+        // wrapped round the edge of the board
+        return dx==1 ? ~BATCH_FILE_A : dx==2 ? ~(BATCH_FILE_A|BATCH_FILE_B)
+            : dx==-1 ? ~BATCH_FILE_H : dx==-2 ? ~(BATCH_FILE_G|BATCH_FILE_H) : ~0ULL;
+    }
+
+    // D squares along the board's numbering (positive is south or
+    // east), DX of them files sideways
+    template<int D> inline BatchVec bv_shift(BatchVec v){
+        return D>0 ? bv_shl<(D>0 ? D : 0)>(v) : bv_shr<(D>0 ? 0 : -D)>(v);
+    }
+
+    template<int D, int DX> inline BatchVec bv_step(BatchVec v){
+        return bv_and(bv_shift<D>(v), bv_set1(batch_wrap(DX)));
+    }
+
+    template<int D, int DX> inline BatchVec bv_slide(BatchVec from, BatchVec empty){
+        // Kogge-Stone: fill along the ray through empty squares in
+        // doubling steps, then one more step onto the first man hit
+        const BatchVec wrap=bv_set1(batch_wrap(DX));
+        BatchVec gen=from, pro=bv_and(empty, wrap);
+        gen=bv_or(gen, bv_and(pro, bv_shift<D>(gen)));
+        pro=bv_and(pro, bv_shift<D>(pro));
+        gen=bv_or(gen, bv_and(pro, bv_shift<2*D>(gen)));
+        pro=bv_and(pro, bv_shift<2*D>(pro));
+        gen=bv_or(gen, bv_and(pro, bv_shift<4*D>(gen)));
+        return bv_and(bv_shift<D>(gen), wrap);
+    }
+
+    class PositionBatch{
+        public:
+            // the input: men by side, type and lane, and each lane's en
+            // passant square as a bit (0 for none)
+            uint64_t pieces[2][6][BATCH_LANES];
+            uint64_t enpassant[BATCH_LANES];
+            // lanes holding a position, from 0
+            int count;
+            // the output of compute(): squares each side attacks, the
+            // moves it would have on the move (as generate() makes them:
+            // no castling, a promotion is one move; but en passant for
+            // every pawn that can take, where generate() lets only the
+            // first), and the material with piece squares, white minus
+            // black
+            uint64_t attacks[2][BATCH_LANES];
+            uint64_t moves[2][BATCH_LANES];
+            int64_t material[BATCH_LANES];
+
+            PositionBatch(){
+                clear();
+            }
+
+            void clear(){
+                for(int side=0; side<2; side++)
+                    for(int t=0; t<6; t++)
+                        for(int i=0; i<BATCH_LANES; i++) pieces[side][t][i]=0;
+                for(int i=0; i<BATCH_LANES; i++) enpassant[i]=0;
+                count=0;
+            }
+
+            void load(int lane, const Board &board){
+                for(int side=0; side<2; side++)
+                    for(int t=0; t<6; t++) pieces[side][t][lane]=0;
+                for(int sq=0; sq<64; sq++){
+                    char p=board.a[sq>>3][sq&7];
+                    int t;
+                    switch(p|0x20){
+                        case 'p': t=0; break;
+                        case 'n': t=1; break;
+                        case 'b': t=2; break;
+                        case 'r': t=3; break;
+                        case 'q': t=4; break;
+                        case 'k': t=5; break;
+                        default: continue;
+                    }
+                    pieces[(p>='A' && p<='Z') ? SIDE_WHITE : SIDE_BLACK][t][lane]|=1ULL<<sq;
+                }
+                enpassant[lane]=board.enpassant_square<64 ? 1ULL<<board.enpassant_square : 0;
+                if(lane>=count) count=lane+1;
+            }
+
+            bool add(const Board &board){
+                // false when full
+                if(count==BATCH_LANES) return false;
+                load(count, board);
+                return true;
+            }
+
+            void compute(){
+                BatchVec men[2];
+                for(int side=0; side<2; side++){
+                    men[side]=bv_zero();
+                    for(int t=0; t<6; t++) men[side]=bv_or(men[side], bv_load(pieces[side][t]));
+                }
+                BatchVec empty=bv_andnot(bv_set1(~0ULL), bv_or(men[0], men[1]));
+                for(int side=0; side<2; side++){
+                    BatchVec all, n;
+                    side_attacks(side, men, empty, all, n);
+                    bv_store(attacks[side], all);
+                    bv_store(moves[side], n);
+                }
+                material_scores();
+            }
+
+            void side_attacks(int side, const BatchVec men[2], BatchVec empty, BatchVec &all, BatchVec &n){
+                // a slider's ray in one direction ends at the first man,
+                // so two rays the same way never share a square, and a
+                // shift moves each man to a different square: the moves
+                // of a whole set of men are counted with one popcount a
+                // direction
+                const BatchVec own=men[side], enemy=men[1-side];
+                BatchVec pawns=bv_load(pieces[side][0]);
+                BatchVec knights=bv_load(pieces[side][1]);
+                BatchVec kings=bv_load(pieces[side][5]);
+                BatchVec queens=bv_load(pieces[side][4]);
+                BatchVec rooks=bv_or(bv_load(pieces[side][3]), queens);
+                BatchVec bishops=bv_or(bv_load(pieces[side][2]), queens);
+                BatchVec s[8];
+                s[0]=bv_slide<-8, 0>(rooks, empty);
+                s[1]=bv_slide<8, 0>(rooks, empty);
+                s[2]=bv_slide<1, 1>(rooks, empty);
+                s[3]=bv_slide<-1, -1>(rooks, empty);
+                s[4]=bv_slide<-7, 1>(bishops, empty);
+                s[5]=bv_slide<-9, -1>(bishops, empty);
+                s[6]=bv_slide<9, 1>(bishops, empty);
+                s[7]=bv_slide<7, -1>(bishops, empty);
+                BatchVec j[8];
+                j[0]=bv_step<-17, -1>(knights);
+                j[1]=bv_step<-15, 1>(knights);
+                j[2]=bv_step<-10, -2>(knights);
+                j[3]=bv_step<-6, 2>(knights);
+                j[4]=bv_step<6, -2>(knights);
+                j[5]=bv_step<10, 2>(knights);
+                j[6]=bv_step<15, -1>(knights);
+                j[7]=bv_step<17, 1>(knights);
+                BatchVec k[8];
+                k[0]=bv_step<-9, -1>(kings);
+                k[1]=bv_step<-8, 0>(kings);
+                k[2]=bv_step<-7, 1>(kings);
+                k[3]=bv_step<-1, -1>(kings);
+                k[4]=bv_step<1, 1>(kings);
+                k[5]=bv_step<7, -1>(kings);
+                k[6]=bv_step<8, 0>(kings);
+                k[7]=bv_step<9, 1>(kings);
+                BatchVec left, right, push, twice;
+                // pawn captures to either side, pushes and double pushes
+                // from the second rank; en passant lands on the sixth
+                // rank for white and the third for black
+                BatchVec ep=bv_load(enpassant);
+                if(side==SIDE_WHITE){
+                    left=bv_step<-9, -1>(pawns);
+                    right=bv_step<-7, 1>(pawns);
+                    push=bv_and(bv_shift<-8>(pawns), empty);
+                    twice=bv_and(bv_shift<-8>(bv_and(push, bv_set1(0xFFULL<<40))), empty);
+                    ep=bv_and(ep, bv_set1(0xFFULL<<16));
+                }
+                else{
+                    left=bv_step<7, -1>(pawns);
+                    right=bv_step<9, 1>(pawns);
+                    push=bv_and(bv_shift<8>(pawns), empty);
+                    twice=bv_and(bv_shift<8>(bv_and(push, bv_set1(0xFFULL<<16))), empty);
+                    ep=bv_and(ep, bv_set1(0xFFULL<<40));
+                }
+                BatchVec takes=bv_or(enemy, ep);
+                all=bv_or(left, right);
+                n=bv_add(bv_popcount(bv_and(left, takes)), bv_popcount(bv_and(right, takes)));
+                n=bv_add(n, bv_add(bv_popcount(push), bv_popcount(twice)));
+                for(int d=0; d<8; d++){
+                    all=bv_or(all, bv_or(s[d], bv_or(j[d], k[d])));
+                    n=bv_add(n, bv_popcount(bv_andnot(s[d], own)));
+                    n=bv_add(n, bv_popcount(bv_andnot(j[d], own)));
+                    n=bv_add(n, bv_popcount(bv_andnot(k[d], own)));
+                }
+            }
+
+            void material_scores(){
+                // the values are a multiply per type on the men counts;
+                // the piece squares are a lookup per man, which gathers
+                // can't do faster at 32 men, so they go lane by lane
+                const int value[6]={PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, KING_VALUE};
+                const int *table[6]={PAWN_PSQ, KNIGHT_PSQ, BISHOP_PSQ, ROOK_PSQ, QUEEN_PSQ, KING_PSQ};
+                BatchVec sum=bv_zero();
+                for(int t=0; t<6; t++){
+                    sum=bv_add(sum, bv_mul(bv_popcount(bv_load(pieces[SIDE_WHITE][t])), value[t]));
+                    sum=bv_sub(sum, bv_mul(bv_popcount(bv_load(pieces[SIDE_BLACK][t])), value[t]));
+                }
+                bv_store(reinterpret_cast<uint64_t *>(material), sum);
+                for(int lane=0; lane<count; lane++){
+                    int64_t psq=0;
+                    for(int t=0; t<6; t++){
+                        for(uint64_t b=pieces[SIDE_WHITE][t][lane]; b; b&=b-1) psq+=table[t][lowest(b)];
+                        // black reads the tables upside down
+                        for(uint64_t b=pieces[SIDE_BLACK][t][lane]; b; b&=b-1) psq-=table[t][lowest(b)^56];
+                    }
+                    material[lane]+=psq;
+                }
+            }
+
+            static int lowest(uint64_t b){
+                return static_cast<int>(std::bitset<64>((b&(0-b))-1).count());
+            }
+    };
+}
+
+#define _batch_h
+#endif
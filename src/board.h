@@ -1,21 +1,154 @@
+#ifndef _board_h
+
+#include <atomic>
 #include <bitset>
+#include <cctype>
+#include <chrono>
+#include <iostream>
 #include <list>
 #include <limits.h>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 #include "debug.h"
+#include "log.h"
 #include "moves.h"
 #include "psq.h"
+#include "stats.h"
+#include "nnue.h"
+#include "tt.h"
+#include "learn.h"
+#include "attacks.h"
+#include "trace.h"
+#include "profile.h"
 
 #define MOBILITY_DRAG 10
 
 int ROOT_DEPTH = 5;
 int CAPTURE_DEPTH = 7;
+// what a draw is worth to the side the engine plays, in centipawns.
+// keeps it from repeating its way out of positions it stands well in.
+int CONTEMPT = 20;
+// frontier pruning, per ply of depth left: a quiet move is skipped when
+// even this much gain can't lift the static score to alpha (futility),
+// a node is cut when the static score beats beta by this much (reverse
+// futility), and a node this far below alpha only gets a quiescence
+// search (razoring). all of it stops FRONTIER_DEPTH plies from the leaves.
+int FUTILITY_MARGIN = 150;
+int RFP_MARGIN = 120;
+int RAZOR_MARGIN = 300;
+int FRONTIER_DEPTH = 3;
+// scores past this are a mate rather than material, and nothing is
+// pruned near them
+#define MATE_BOUND 10000
+// a side mated at ply p of the search scores MATE_SCORE-p against it,
+// so a shorter mate is a better score
+#define MATE_SCORE 30000
+// what a search node is, as a template argument: the root, on the
+// principal variation, or off it
+#define NODE_ROOT 0
+#define NODE_PV 1
+#define NODE_NONPV 2
+// the order a node tries its moves in, each stage generated only when
+// the ones before it haven't cut: the table's move, captures, the
+// killers (quiet moves that cut at the same ply elsewhere), the rest
+#define STAGE_HASH 0
+#define STAGE_CAPTURE 1
+#define STAGE_KILLER 2
+#define STAGE_QUIET 3
+// positional terms read off the attack tables, in centipawns. by piece
+// type (N B R Q): per safe square reached beyond a typical number of
+// them, and what one attacked square next to the enemy king weighs.
+int MOBILITY_WEIGHT[4] = {4, 4, 2, 1};
+int MOBILITY_BASE[4] = {4, 6, 6, 12};
+int KING_ATTACK_WEIGHT[4] = {2, 2, 3, 5};
+// a king attack only counts with several pieces in it: the weight above,
+// times KING_DANGER, times this percentage for the number of attackers
+int KING_ATTACKERS[8] = {0, 0, 50, 75, 88, 94, 97, 99};
+int KING_DANGER = 8;
+// a castled king's own pawns, right in front of it and one further up
+int PAWN_SHIELD[2] = {12, 6};
+
+#define MAX_GAME_PLY 2048
 
 namespace bigdumb{
+    int mate_in(int score){
+        // plies to the mate a score stands for, -1 when it is no mate
+        int x=score<0 ? -score : score;
+        return x>MATE_SCORE-MAX_GAME_PLY && x<=MATE_SCORE ? MATE_SCORE-x : -1;
+    }
+
+    class SearchContext{
+        public:
+            // position key at every half_move of the game so far plus the
+            // current search path. board copies made by the search share
+            // one context, and since the search is depth-first a ply's slot
+            // is just overwritten by the next sibling.
+            unsigned long long keys[MAX_GAME_PLY];
+            // per search settings, so boards in different threads can
+            // play with different ones.
+            int contempt;
+            int futility_margin;
+            int rfp_margin;
+            int razor_margin;
+            // depth the current search started at, which bounds the
+            // check extensions, and the move picked at the root.
+            int root_depth;
+            ChessMove best;
+            int root_ply;
+            // two quiet moves per search ply that cut there last, newest
+            // first; from is -1 in an empty slot
+            ChessMove killers[MAX_PLY][2];
+            // counters for this thread's searches; whoever runs several
+            // contexts merges them.
+            SearchStats stats;
+            // network accumulators by search ply, when USE_NNUE is on
+            std::vector<Accumulator> accumulators;
+            // the table this context probes, the global one unless the
+            // caller wants its searches kept apart
+            TranspositionTable *tt;
+            // root moves the search skips; MultiPV fills it with the
+            // lines already reported
+            std::vector<ChessMove> excluded;
+            // how many of those are legal; illegal ones leave the root's
+            // result as good as a full search
+            int excluded_legal;
+            // records the tree when tracing is compiled in and on
+            std::shared_ptr<Tracer> tracer;
+            // set from another thread to abandon the search; the
+            // result of a stopped search means nothing
+            std::atomic<bool> stop;
+            // when timed, the search stops itself at the deadline
+            bool timed;
+            std::chrono::steady_clock::time_point deadline;
+            // and after this many nodes, when not 0
+            long long node_limit;
+
+            SearchContext(){
+                for(int i=0; i<MAX_GAME_PLY; i++) keys[i]=0;
+                clear_killers();
+                contempt=CONTEMPT;
+                futility_margin=FUTILITY_MARGIN;
+                rfp_margin=RFP_MARGIN;
+                razor_margin=RAZOR_MARGIN;
+                root_depth=0;
+                root_ply=0;
+                excluded_legal=0;
+                tt=&TT;
+                stop=false;
+                timed=false;
+                node_limit=0;
+            }
+
+            void clear_killers(){
+                for(int i=0; i<MAX_PLY; i++) killers[i][0].from=killers[i][1].from=-1;
+            }
+    };
+
     class Board{
         public:
             char a[8][8];
-            int psq_value;
             std::bitset<64> white;
             std::bitset<64> black;
             std::bitset<64> pawns;
@@ -26,7 +159,9 @@ namespace bigdumb{
             std::bitset<64> kings;
             std::bitset<64> empty;
             std::bitset<64> occupied;
-            std::bitset<64> attackmap;
+            // attack tables for this position, built on first use
+            AttackInfo attack_info;
+            bool attacks_ready;
             std::string variation;
             //
             std::list<ChessMove> quiet;
@@ -37,8 +172,16 @@ namespace bigdumb{
             bool white_can_castle;
             bool black_can_castle;
             int enpassant_square;
+            // plies since the last capture or pawn move
+            int fifty_clock;
+            unsigned long long key;
+            // piece counts, see material.h
+            unsigned long long material_key;
+            std::shared_ptr<SearchContext> context;
+            bool engine_white;
             Board();
             void print_board();
+            std::string board_string();
             //
             bool valid_file(char);
             bool valid_rank(char);
@@ -47,47 +190,61 @@ namespace bigdumb{
             void move(std::string);
             void move(int,int);
             //
+            bool set_fen(std::string);
+            std::string fen();
+            std::string san(int,int);
+            //
             bool is_white(char);
             bool is_black(char);
             //
-            void gen_w_rook_moves(int, int);
-            void gen_b_rook_moves(int, int);
-            //
-            void gen_w_bishop_moves(int, int);
-            void gen_b_bishop_moves(int, int);
-            //
-            void gen_w_queen_moves(int, int);
-            void gen_b_queen_moves(int, int);
+            bool attacked(int, bool);
+            bool in_check(bool);
+            bool legal(int,int);
+            std::list<ChessMove> legal_moves();
+            std::string coord(int,int);
+            const AttackInfo &attacks();
             //
-            void gen_b_pawn_moves(int,int);
-            void gen_w_pawn_moves(int,int);
-            //
-            void gen_b_knight_moves(int,int);
-            void gen_w_knight_moves(int,int);
-            //
-            void gen_w_king_moves(int,int);
-            void gen_b_king_moves(int,int);
+            unsigned long long compute_key();
+            unsigned long long compute_material_key();
+            void push_key();
+            bool is_draw();
+            int draw_value();
+            void count_node();
+            void count_cutoff(int);
+            bool probe_tt(int, int, int, TTEntry &);
+            void store_tt(int, int, int, int, int, int);
+            bool excluded(int, int);
+            void add_killer(int, int);
+            std::string pv(int);
             //
+            template<int SIDE> void gen_pawn_moves(int, const std::bitset<64> &);
+            template<int SIDE> void generate_captures();
+            template<int SIDE> void generate_quiets();
+            template<int SIDE> void generate();
+            template<int SIDE> bool pseudo_legal(int, int);
             void gen_moves();
             //
             void gen_knightmap();
             //
-            void add_move_from_bitmap(int,std::bitset<64>);
+            void add_move_from_bitmap(int,std::bitset<64>,int mobility=-1);
             //
             void print_quiet();
             void print_capture();
             //
+            int search(int);
+            std::string think(int, int);
             int abmax(int,int,int);
-			int abmin(int,int,int);
-			int qblack(int,int);
-			int qwhite(int,int);
-			int board_white_value();
-			int board_black_value();
-            //
-            int board_value();
-            //
-            int mobility;
-			//
+            int abmin(int,int,int);
+            template<int SIDE, int NODE> int alphabeta(int,int,int);
+            template<int SIDE> int quiesce(int,int,int);
+            template<int SIDE, int NODE> bool frontier(int);
+            template<int SIDE> bool better(int,int);
+            bool bounded(int);
+            template<int SIDE> int material();
+            int evaluate();
+            int endgame(const MaterialEntry &);
+            template<int SIDE> int positional(const AttackInfo &);
+            template<int SIDE> int pawn_shield(const AttackInfo &);
     };
 
     Board::Board(){
@@ -134,11 +291,17 @@ namespace bigdumb{
         white_can_castle = true;
         black_can_castle = true;
         enpassant_square = 64;
-        mobility=0;
+        fifty_clock=0;
+        engine_white=false;
+        attacks_ready=false;
+        context=std::make_shared<SearchContext>();
+        key=compute_key();
+        material_key=compute_material_key();
+        push_key();
     }
 
     void Board::recompute_bitboards(){
-        attackmap.reset();
+        PROFILE(PROF_BITBOARDS);
         rooks.reset();
         bishops.reset();
         knights.reset();
@@ -174,23 +337,29 @@ namespace bigdumb{
     }
 
     void Board::print_board(){
-        // prints the board array in a
+        std::cerr << board_string();
+    }
+
+    std::string Board::board_string(){
+        // the board array in a
         // nice format.
-        std::cerr << "\n";
+        std::ostringstream out;
+        out << "\n";
         for(int y=0; y<8; y++){
-            std::cerr << " "<< 8-y<<" ";
+            out << " "<< 8-y<<" ";
             for(int x=0; x<8; x++){
-                std::cerr << a[y][x] <<" ";
+                out << a[y][x] <<" ";
             }
-            std::cerr << "\n";
+            out << "\n";
         }
-        std::cerr << "   a b c d e f g h\n";
-        std::cerr << half_move << " ";
-        if(half_move%2 == 0) std::cerr << "White to move\n";
-        else std::cerr << "Black to move\n";
-        //if(white_can_castle) std::cerr << "[white can castle]\n";
-        //if(black_can_castle) std::cerr << "[black can castle]\n";
-        //if(enpassant_square<64) std::cerr << "enpassant: " << enpassant_square << "\n";
+        out << "   a b c d e f g h\n";
+        out << half_move << " ";
+        if(half_move%2 == 0) out << "White to move\n";
+        else out << "Black to move\n";
+        //if(white_can_castle) out << "[white can castle]\n";
+        //if(black_can_castle) out << "[black can castle]\n";
+        //if(enpassant_square<64) out << "enpassant: " << enpassant_square << "\n";
+        return out.str();
     }
 
     void Board::move(std::string crd){
@@ -213,500 +382,447 @@ namespace bigdumb{
             << "recognized as a piece, promotion can't be done";
             kill_engine();
         }
-        std::cerr << "received move " << crd << "\n";
+        LOG_INFO("received move " << crd);
+        char mover=a['8'-crd[1]][crd[0]-'a'];
+        if(a['8'-crd[3]][crd[2]-'a']!='.' || mover=='p' || mover=='P') fifty_clock=0;
+        else fifty_clock++;
+        // a pawn moving sideways onto an empty square takes en passant
+        if((mover=='p' || mover=='P') && crd[0]!=crd[2] && a['8'-crd[3]][crd[2]-'a']=='.')
+            a['8'-crd[1]][crd[2]-'a']='.';
         if(crd.length()==4)
             a['8'-crd[3]][crd[2]-'a']=a['8'-crd[1]][crd[0]-'a'];
+        else if(is_white(mover))
+            a['8'-crd[3]][crd[2]-'a']=toupper(crd[4]);
         else
-            a['8'-crd[3]][crd[2]-'a']=crd[4];
+            a['8'-crd[3]][crd[2]-'a']=tolower(crd[4]);
         a['8'-crd[1]][crd[0]-'a']='.';
         half_move++;
-        if(crd=="e1g1" && a[7][6]=='K') white_can_castle=false;
-        if(crd=="e1c1" && a[7][2]=='K') white_can_castle=false;
-        if(crd=="e8g8" && a[0][6]=='k') black_can_castle=false;
-        if(crd=="e8c8" && a[0][2]=='k') black_can_castle=false;
+        if(crd=="e1g1" && a[7][6]=='K'){ white_can_castle=false; a[7][7]='.'; a[7][5]='R'; }
+        if(crd=="e1c1" && a[7][2]=='K'){ white_can_castle=false; a[7][0]='.'; a[7][3]='R'; }
+        if(crd=="e8g8" && a[0][6]=='k'){ black_can_castle=false; a[0][7]='.'; a[0][5]='r'; }
+        if(crd=="e8c8" && a[0][2]=='k'){ black_can_castle=false; a[0][0]='.'; a[0][3]='r'; }
+        if(mover=='K') white_can_castle=false;
+        if(mover=='k') black_can_castle=false;
+        // the square skipped over, which is what the pawn generators test
         if(crd[1]=='2' && crd[3]=='4' && a['8'-crd[3]][crd[2]-'a']=='P')
-            enpassant_square=48+crd[0]-'a';
-        else if(crd[1]=='7' && crd[3]=='5' && a['8'-crd[3]][crd[2]-'a']=='P')
+            enpassant_square=40+crd[0]-'a';
+        else if(crd[1]=='7' && crd[3]=='5' && a['8'-crd[3]][crd[2]-'a']=='p')
             enpassant_square=16+crd[0]-'a';
         else enpassant_square=64;
         recompute_bitboards();
-        print_board();
+        attacks_ready=false;
+        key=compute_key();
+        material_key=compute_material_key();
+        push_key();
+        LOG_DEBUG(board_string());
     }
 
     void Board::move(int from, int to){
-        a[to/8][to%8]=a[from/8][from%8];
+        char p=a[from/8][from%8], c=a[to/8][to%8];
+        bool pawn=p=='p' || p=='P';
+        if(c!='.' || pawn) fifty_clock=0;
+        else fifty_clock++;
+        // callers always advance half_move right after, so flip the
+        // side to move in the key here as well.
+        key^=ZOBRIST[piece_index(p)][from] ^ ZOBRIST[piece_index(p)][to] ^ ZOBRIST_SIDE;
+        // a pawn moving sideways onto the en passant square takes the
+        // pawn beside it
+        int taken=to;
+        if(pawn && to==enpassant_square && (from&7)!=(to&7)){
+            taken=(from&~7)|(to&7);
+            c=a[taken>>3][taken&7];
+            a[taken>>3][taken&7]='.';
+        }
+        if(c!='.'){
+            key^=ZOBRIST[piece_index(c)][taken];
+            material_key-=MATERIAL_UNIT[piece_index(c)];
+        }
+        if(enpassant_square<64) key^=ZOBRIST_EP[enpassant_square&7];
+        enpassant_square=pawn && (from-to==16 || to-from==16) ? (from+to)/2 : 64;
+        if(enpassant_square<64) key^=ZOBRIST_EP[enpassant_square&7];
+        a[to/8][to%8]=p;
         a[from/8][from%8]='.';
+        attacks_ready=false;
+        if(USE_NNUE && !context->accumulators.empty()){
+            int ply=half_move-context->root_ply;
+            if(ply>=0 && ply<MAX_PLY)
+                nnue_update(context->accumulators[ply], context->accumulators[ply+1], p, c, from, to, taken, a);
+        }
     }
 
-    bool Board::valid_file(char f){
-        return f>='a' && f<='h';
+    unsigned long long Board::compute_key(){
+        unsigned long long k=0;
+        for(int i=0; i<64; i++){
+            int p=piece_index(a[i>>3][i&7]);
+            if(p>=0) k^=ZOBRIST[p][i];
+        }
+        if(half_move%2) k^=ZOBRIST_SIDE;
+        if(white_can_castle) k^=ZOBRIST_CASTLE[0];
+        if(black_can_castle) k^=ZOBRIST_CASTLE[1];
+        if(enpassant_square<64) k^=ZOBRIST_EP[enpassant_square&7];
+        return k;
     }
 
-    bool Board::valid_rank(char r){
-        return r>='1' && r<='8';
+    unsigned long long Board::compute_material_key(){
+        unsigned long long k=0;
+        for(int i=0; i<64; i++){
+            int p=piece_index(a[i>>3][i&7]);
+            if(p>=0) k+=MATERIAL_UNIT[p];
+        }
+        return k;
     }
 
-    bool Board::valid_piece(char p){
-        return p=='r' || p=='R'
-            || p=='n' || p=='N'
-            || p=='b' || p=='B'
-            || p=='q' || p=='Q'
-            || p=='k' || p=='K'
-            || p=='p' || p=='P';
+    void Board::push_key(){
+        if(half_move<MAX_GAME_PLY) context->keys[half_move]=key;
     }
 
-    void Board::gen_w_rook_moves(int y, int x){
-        std::bitset<64> rook_moves;
-        std::bitset<64> up_moves=UP[8*y+x] & occupied;
-        up_moves = up_moves >> 8 | up_moves >> 16 | up_moves >> 24 |
-                    up_moves >> 32| up_moves >> 40 | up_moves >> 48;
-        up_moves = up_moves & UP[8*y+x];
-        up_moves = UP[8*y+x] ^ up_moves;
-        up_moves = up_moves & (~white);
-
-        std::bitset<64> down_moves=DOWN[8*y+x] & occupied;
-        down_moves = down_moves << 8 | down_moves << 16 | down_moves << 24 |
-                    down_moves << 32| down_moves << 40 | down_moves << 48;
-        down_moves = down_moves & DOWN[8*y+x];
-        down_moves = DOWN[8*y+x] ^ down_moves;
-        down_moves = down_moves & (~white);
-
-        std::bitset<64> right_moves=RIGHT[8*y+x] & occupied;
-        right_moves = right_moves << 1 | right_moves << 2 | right_moves << 3 |
-                    right_moves << 4 | right_moves << 5 | right_moves << 6;
-        right_moves = right_moves & RIGHT[8*y+x];
-        right_moves = RIGHT[8*y+x] ^ right_moves;
-        right_moves = right_moves & (~white);
-
-        std::bitset<64> left_moves = LEFT[8*y+x] & occupied;
-        left_moves = left_moves >> 1 | left_moves >> 2 | left_moves >> 3 |
-                    left_moves >> 4 | left_moves >> 5 | left_moves >> 6;
-        left_moves = left_moves & LEFT[8*y+x];
-        left_moves = LEFT[8*y+x] ^ left_moves;
-        left_moves = left_moves & (~white);
-
-        rook_moves = up_moves | left_moves | right_moves | down_moves;
-        if(rook_moves.any()){
-            //print(rook_moves);
-            //std::cerr << "moves for rook at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, rook_moves);
+    bool Board::is_draw(){
+        if(fifty_clock>=100) return true;
+        // nothing before the last capture or pawn move can come back, and
+        // a position can only recur with the same side to move, so look at
+        // every other ply back to there.
+        int stop=half_move-fifty_clock;
+        if(stop<0) stop=0;
+        for(int i=half_move-4; i>=stop; i-=2){
+            if(i<MAX_GAME_PLY && context->keys[i]==key) return true;
         }
-        mobility+=rook_moves.count();
-        attackmap|=rook_moves;
-
+        return false;
     }
 
-    void Board::gen_b_rook_moves(int y, int x){
-        std::bitset<64> rook_moves;
-        std::bitset<64> up_moves=UP[8*y+x] & occupied;
-        up_moves = up_moves >> 8 | up_moves >> 16 | up_moves >> 24 |
-                    up_moves >> 32| up_moves >> 40 | up_moves >> 48;
-        up_moves = up_moves & UP[8*y+x];
-        up_moves = UP[8*y+x] ^ up_moves;
-        up_moves = up_moves & (~black);
-
-        std::bitset<64> down_moves=DOWN[8*y+x] & occupied;
-        down_moves = down_moves << 8 | down_moves << 16 | down_moves << 24 |
-                    down_moves << 32| down_moves << 40 | down_moves << 48;
-        down_moves = down_moves & DOWN[8*y+x];
-        down_moves = DOWN[8*y+x] ^ down_moves;
-        down_moves = down_moves & (~black);
-
-        std::bitset<64> right_moves=RIGHT[8*y+x] & occupied;
-        right_moves = right_moves << 1 | right_moves << 2 | right_moves << 3 |
-                    right_moves << 4 | right_moves << 5 | right_moves << 6;
-        right_moves = right_moves & RIGHT[8*y+x];
-        right_moves = RIGHT[8*y+x] ^ right_moves;
-        right_moves = right_moves & (~black);
-
-        std::bitset<64> left_moves = LEFT[8*y+x] & occupied;
-        left_moves = left_moves >> 1 | left_moves >> 2 | left_moves >> 3 |
-                    left_moves >> 4 | left_moves >> 5 | left_moves >> 6;
-        left_moves = left_moves & LEFT[8*y+x];
-        left_moves = LEFT[8*y+x] ^ left_moves;
-        left_moves = left_moves & (~black);
-
-        rook_moves = up_moves | right_moves | left_moves | down_moves;
-        if(rook_moves.any()){
-            //print(rook_moves);
-            //std::cerr << "moves for rook at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, rook_moves);
-
-        }
-        mobility+=rook_moves.count();
-        attackmap|=rook_moves;
+    void Board::count_node(){
+        context->stats.nodes++;
+        if(context->timed && (context->stats.nodes&1023)==0
+                && std::chrono::steady_clock::now()>=context->deadline) context->stop=true;
+        if(context->node_limit && context->stats.nodes>=context->node_limit) context->stop=true;
+        int ply=half_move-context->root_ply;
+        if(ply>=0 && ply<MAX_PLY) context->stats.ply_nodes[ply]++;
     }
 
-    void Board::gen_w_bishop_moves(int y, int x){
-        std::bitset<64> bishop_moves;
-
-        std::bitset<64> left_up_moves = LEFTUP[8*y+x] & occupied;
-        left_up_moves = left_up_moves >> 9 | left_up_moves >> 18 | left_up_moves >> 27
-                    |   left_up_moves >> 36| left_up_moves >> 45 | left_up_moves >> 54;
-        left_up_moves = left_up_moves & LEFTUP[8*y+x];
-        left_up_moves = left_up_moves ^ LEFTUP[8*y+x];
-        left_up_moves = left_up_moves & (~white);
-
-        std::bitset<64> right_up_moves = RIGHTUP[8*y+x] & occupied;
-        right_up_moves = right_up_moves >> 7 | right_up_moves >> 14 | right_up_moves >> 21
-                        | right_up_moves >> 28 | right_up_moves >> 35 | right_up_moves >> 42;
-        right_up_moves = right_up_moves & RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves ^ RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves & (~white);
-
-        std::bitset<64> left_down_moves = LEFTDOWN[8*y+x] & occupied;
-        left_down_moves = left_down_moves << 7 | left_down_moves << 14 | left_down_moves << 21
-                        | left_down_moves << 28 | left_down_moves << 35 | left_down_moves << 42;
-        left_down_moves = left_down_moves & LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves ^ LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves & (~white);
-
-        std::bitset<64> right_down_moves = RIGHTDOWN[8*y+x] & occupied;
-        right_down_moves = right_down_moves << 9 | right_down_moves << 18 | right_down_moves << 27
-                        | right_down_moves << 36 | right_down_moves << 45 | right_down_moves << 54;
-        right_down_moves = right_down_moves & RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves ^ RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves & (~white);
-
-        bishop_moves = left_up_moves | right_down_moves | right_up_moves | left_down_moves;
-        if(bishop_moves.any()){
-            //print(bishop_moves);
-            //std::cerr << "moves for bishop at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, bishop_moves);
+    void Board::count_cutoff(int searched){
+        context->stats.fail_high++;
+        if(searched==1) context->stats.fail_high_first++;
+    }
 
+    bool Board::probe_tt(int depth, int alpha, int beta, TTEntry &entry){
+        // true when the table settles this node, the score in entry.
+        // otherwise entry.from is the move to try first, or -1.
+        context->stats.tt_probes++;
+        if(!context->tt->probe(key, entry)){
+            entry.from=-1;
+            return false;
+        }
+        context->stats.tt_hits++;
+        // mates are stored as distances from the node, not the root
+        int ply=half_move-context->root_ply;
+        if(mate_in(entry.score)>=0) entry.score+=entry.score>0 ? -ply : ply;
+        if(entry.depth<depth || ply==0) return false;
+        if(entry.flag==TT_EXACT || (entry.flag==TT_LOWER && entry.score>=beta)
+                || (entry.flag==TT_UPPER && entry.score<=alpha)){
+            context->stats.tt_cutoffs++;
+            return true;
         }
-        mobility+=bishop_moves.count();
-        attackmap|=bishop_moves;
+        return false;
     }
 
-    void Board::gen_b_bishop_moves(int y, int x){
-        std::bitset<64> bishop_moves;
-
-        std::bitset<64> left_up_moves = LEFTUP[8*y+x] & occupied;
-        left_up_moves = left_up_moves >> 9 | left_up_moves >> 18 | left_up_moves >> 27
-                    |   left_up_moves >> 36| left_up_moves >> 45 | left_up_moves >> 54;
-        left_up_moves = left_up_moves & LEFTUP[8*y+x];
-        left_up_moves = left_up_moves ^ LEFTUP[8*y+x];
-        left_up_moves = left_up_moves & (~black);
-
-        std::bitset<64> right_up_moves = RIGHTUP[8*y+x] & occupied;
-        right_up_moves = right_up_moves >> 7 | right_up_moves >> 14 | right_up_moves >> 21
-                        | right_up_moves >> 28 | right_up_moves >> 35 | right_up_moves >> 42;
-        right_up_moves = right_up_moves & RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves ^ RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves & (~black);
-
-        std::bitset<64> left_down_moves = LEFTDOWN[8*y+x] & occupied;
-        left_down_moves = left_down_moves << 7 | left_down_moves << 14 | left_down_moves << 21
-                        | left_down_moves << 28 | left_down_moves << 35 | left_down_moves << 42;
-        left_down_moves = left_down_moves & LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves ^ LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves & (~black);
-
-        std::bitset<64> right_down_moves = RIGHTDOWN[8*y+x] & occupied;
-        right_down_moves = right_down_moves << 9 | right_down_moves << 18 | right_down_moves << 27
-                        | right_down_moves << 36 | right_down_moves << 45 | right_down_moves << 54;
-        right_down_moves = right_down_moves & RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves ^ RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves & (~black);
-
-        bishop_moves = left_up_moves | right_down_moves | right_up_moves | left_down_moves;
-        if(bishop_moves.any()){
-            //print(bishop_moves);
-            //std::cerr << "moves for bishop at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, bishop_moves);
+    void Board::store_tt(int depth, int score, int alpha, int beta, int from, int to){
+        // alpha and beta are the window the node was searched with
+        if(context->stop || from<0) return;
+        // a root with moves left out didn't see the whole position
+        int ply=half_move-context->root_ply;
+        if(ply==0 && context->excluded_legal) return;
+        int flag=TT_EXACT;
+        if(score<=alpha) flag=TT_UPPER;
+        else if(score>=beta) flag=TT_LOWER;
+        if(mate_in(score)>=0) score+=score>0 ? ply : -ply;
+        context->tt->store(key, score, depth, flag, from, to);
+    }
 
-        }
-        mobility+=bishop_moves.count();
-        attackmap|=bishop_moves;
+    void Board::add_killer(int from, int to){
+        // a quiet move that cut; the older killer makes way
+        int ply=half_move-context->root_ply;
+        if(ply<0 || ply>=MAX_PLY) return;
+        ChessMove *k=context->killers[ply];
+        if(k[0].from==from && k[0].to==to) return;
+        k[1]=k[0];
+        k[0].from=from;
+        k[0].to=to;
     }
 
-    void Board::gen_w_queen_moves(int y, int x){
-        std::bitset<64> queen_moves;
-
-        std::bitset<64> rook_moves;
-        std::bitset<64> up_moves=UP[8*y+x] & occupied;
-        up_moves = up_moves >> 8 | up_moves >> 16 | up_moves >> 24 |
-                    up_moves >> 32| up_moves >> 40 | up_moves >> 48;
-        up_moves = up_moves & UP[8*y+x];
-        up_moves = UP[8*y+x] ^ up_moves;
-        up_moves = up_moves & (~white);
-
-        std::bitset<64> down_moves=DOWN[8*y+x] & occupied;
-        down_moves = down_moves << 8 | down_moves << 16 | down_moves << 24 |
-                    down_moves << 32| down_moves << 40 | down_moves << 48;
-        down_moves = down_moves & DOWN[8*y+x];
-        down_moves = DOWN[8*y+x] ^ down_moves;
-        down_moves = down_moves & (~white);
-
-        std::bitset<64> right_moves=RIGHT[8*y+x] & occupied;
-        right_moves = right_moves << 1 | right_moves << 2 | right_moves << 3 |
-                    right_moves << 4 | right_moves << 5 | right_moves << 6;
-        right_moves = right_moves & RIGHT[8*y+x];
-        right_moves = RIGHT[8*y+x] ^ right_moves;
-        right_moves = right_moves & (~white);
-
-        std::bitset<64> left_moves = LEFT[8*y+x] & occupied;
-        left_moves = left_moves >> 1 | left_moves >> 2 | left_moves >> 3 |
-                    left_moves >> 4 | left_moves >> 5 | left_moves >> 6;
-        left_moves = left_moves & LEFT[8*y+x];
-        left_moves = LEFT[8*y+x] ^ left_moves;
-        left_moves = left_moves & (~white);
-
-        rook_moves = up_moves | left_moves | right_moves | down_moves;
-
-        std::bitset<64> bishop_moves;
-
-        std::bitset<64> left_up_moves = LEFTUP[8*y+x] & occupied;
-        left_up_moves = left_up_moves >> 9 | left_up_moves >> 18 | left_up_moves >> 27
-                    |   left_up_moves >> 36| left_up_moves >> 45 | left_up_moves >> 54;
-        left_up_moves = left_up_moves & LEFTUP[8*y+x];
-        left_up_moves = left_up_moves ^ LEFTUP[8*y+x];
-        left_up_moves = left_up_moves & (~white);
-
-        std::bitset<64> right_up_moves = RIGHTUP[8*y+x] & occupied;
-        right_up_moves = right_up_moves >> 7 | right_up_moves >> 14 | right_up_moves >> 21
-                        | right_up_moves >> 28 | right_up_moves >> 35 | right_up_moves >> 42;
-        right_up_moves = right_up_moves & RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves ^ RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves & (~white);
-
-        std::bitset<64> left_down_moves = LEFTDOWN[8*y+x] & occupied;
-        left_down_moves = left_down_moves << 7 | left_down_moves << 14 | left_down_moves << 21
-                        | left_down_moves << 28 | left_down_moves << 35 | left_down_moves << 42;
-        left_down_moves = left_down_moves & LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves ^ LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves & (~white);
-
-        std::bitset<64> right_down_moves = RIGHTDOWN[8*y+x] & occupied;
-        right_down_moves = right_down_moves << 9 | right_down_moves << 18 | right_down_moves << 27
-                        | right_down_moves << 36 | right_down_moves << 45 | right_down_moves << 54;
-        right_down_moves = right_down_moves & RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves ^ RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves & (~white);
-
-        bishop_moves = left_up_moves | right_down_moves | right_up_moves | left_down_moves;
-
-        queen_moves = bishop_moves | rook_moves;
-        if(queen_moves.any()){
-            //print(queen_moves);
-            //std::cerr << "moves for queen at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, queen_moves);
+    bool Board::excluded(int from, int to){
+        for(size_t i=0; i<context->excluded.size(); i++)
+            if(context->excluded[i].from==from && context->excluded[i].to==to) return true;
+        return false;
+    }
 
+    std::string Board::pv(int depth){
+        // the root move the last search chose, then the table's moves
+        // from there while they are legal
+        std::string line=coord(context->best.from, context->best.to);
+        Board temp_board=*this;
+        temp_board.move(context->best.from, context->best.to);
+        temp_board.half_move++;
+        temp_board.push_key();
+        for(int i=1; i<depth && !temp_board.is_draw(); i++){
+            TTEntry entry;
+            if(!context->tt->probe(temp_board.key, entry)) break;
+            bool found=false;
+            temp_board.gen_moves();
+            std::list<ChessMove>::iterator m;
+            for(m=temp_board.capture.begin(); m!=temp_board.capture.end(); m++)
+                if((*m).from==entry.from && (*m).to==entry.to) found=true;
+            for(m=temp_board.quiet.begin(); m!=temp_board.quiet.end(); m++)
+                if((*m).from==entry.from && (*m).to==entry.to) found=true;
+            if(!found || !temp_board.legal(entry.from, entry.to)) break;
+            line+=" "+temp_board.coord(entry.from, entry.to);
+            temp_board.move(entry.from, entry.to);
+            temp_board.half_move++;
+            temp_board.push_key();
         }
-        mobility+=queen_moves.count();
-        attackmap|=queen_moves;
+        return line;
     }
 
-    void Board::gen_b_queen_moves(int y,int x){
-        std::bitset<64> queen_moves;
-        std::bitset<64> bishop_moves;
-
-        std::bitset<64> left_up_moves = LEFTUP[8*y+x] & occupied;
-        left_up_moves = left_up_moves >> 9 | left_up_moves >> 18 | left_up_moves >> 27
-                    |   left_up_moves >> 36| left_up_moves >> 45 | left_up_moves >> 54;
-        left_up_moves = left_up_moves & LEFTUP[8*y+x];
-        left_up_moves = left_up_moves ^ LEFTUP[8*y+x];
-        left_up_moves = left_up_moves & (~black);
-
-        std::bitset<64> right_up_moves = RIGHTUP[8*y+x] & occupied;
-        right_up_moves = right_up_moves >> 7 | right_up_moves >> 14 | right_up_moves >> 21
-                        | right_up_moves >> 28 | right_up_moves >> 35 | right_up_moves >> 42;
-        right_up_moves = right_up_moves & RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves ^ RIGHTUP[8*y+x];
-        right_up_moves = right_up_moves & (~black);
-
-        std::bitset<64> left_down_moves = LEFTDOWN[8*y+x] & occupied;
-        left_down_moves = left_down_moves << 7 | left_down_moves << 14 | left_down_moves << 21
-                        | left_down_moves << 28 | left_down_moves << 35 | left_down_moves << 42;
-        left_down_moves = left_down_moves & LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves ^ LEFTDOWN[8*y+x];
-        left_down_moves = left_down_moves & (~black);
-
-        std::bitset<64> right_down_moves = RIGHTDOWN[8*y+x] & occupied;
-        right_down_moves = right_down_moves << 9 | right_down_moves << 18 | right_down_moves << 27
-                        | right_down_moves << 36 | right_down_moves << 45 | right_down_moves << 54;
-        right_down_moves = right_down_moves & RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves ^ RIGHTDOWN[8*y+x];
-        right_down_moves = right_down_moves & (~black);
-
-        bishop_moves = left_up_moves | right_down_moves | right_up_moves | left_down_moves;
-
-         std::bitset<64> rook_moves;
-        std::bitset<64> up_moves=UP[8*y+x] & occupied;
-        up_moves = up_moves >> 8 | up_moves >> 16 | up_moves >> 24 |
-                    up_moves >> 32| up_moves >> 40 | up_moves >> 48;
-        up_moves = up_moves & UP[8*y+x];
-        up_moves = UP[8*y+x] ^ up_moves;
-        up_moves = up_moves & (~black);
-
-        std::bitset<64> down_moves=DOWN[8*y+x] & occupied;
-        down_moves = down_moves << 8 | down_moves << 16 | down_moves << 24 |
-                    down_moves << 32| down_moves << 40 | down_moves << 48;
-        down_moves = down_moves & DOWN[8*y+x];
-        down_moves = DOWN[8*y+x] ^ down_moves;
-        down_moves = down_moves & (~black);
-
-        std::bitset<64> right_moves=RIGHT[8*y+x] & occupied;
-        right_moves = right_moves << 1 | right_moves << 2 | right_moves << 3 |
-                    right_moves << 4 | right_moves << 5 | right_moves << 6;
-        right_moves = right_moves & RIGHT[8*y+x];
-        right_moves = RIGHT[8*y+x] ^ right_moves;
-        right_moves = right_moves & (~black);
-
-        std::bitset<64> left_moves = LEFT[8*y+x] & occupied;
-        left_moves = left_moves >> 1 | left_moves >> 2 | left_moves >> 3 |
-                    left_moves >> 4 | left_moves >> 5 | left_moves >> 6;
-        left_moves = left_moves & LEFT[8*y+x];
-        left_moves = LEFT[8*y+x] ^ left_moves;
-        left_moves = left_moves & (~black);
-
-        rook_moves = up_moves | right_moves | left_moves | down_moves;
-        queen_moves = rook_moves | bishop_moves;
-        if(queen_moves.any()){
-            //print(queen_moves);
-            //std::cerr << "moves for queen at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, queen_moves);
-
-        }
-        mobility+=queen_moves.count();
-        attackmap|=queen_moves;
+    int Board::draw_value(){
+        // scores are white minus black
+        return engine_white ? -context->contempt : context->contempt;
     }
 
-    void Board::gen_b_pawn_moves(int y,int x){
-        int index=8*y+x;
-        std::bitset<64> pawn_moves;
-        std::bitset<64> pawn_pushes;
-        std::bitset<64> pawn_cross;
-        if(y<7 && empty.test(index+8)) pawn_pushes.set(index+8);
-        if(y==1 && empty.test(index+8) && empty.test(index+16)) pawn_pushes.set(index+16);
-        if(y<7 && x>0 && white.test(index+7)) pawn_cross.set(index+7);
-        if(y<7 && x<7 && white.test(index+9)) pawn_cross.set(index+9);
-        if(y<7 && x>0 && enpassant_square==index+7){
-            pawn_cross.set(index+7);
-            enpassant_square=64;
-        }
-        if(y<7 && x<7 && enpassant_square==index+9){
-            pawn_cross.set(index+9);
-            enpassant_square=64;
+    bool Board::set_fen(std::string fen){
+        // the first four fields are required; the clocks are optional
+        // so EPD records can be passed straight in.
+        std::istringstream in(fen);
+        std::string placement, side, castle, ep;
+        int clock=0, fullmove=1;
+        if(!(in >> placement >> side >> castle >> ep)) return false;
+        if(!(in >> clock)) clock=0;
+        if(!(in >> fullmove) || fullmove<1) fullmove=1;
+        char b[8][8];
+        int y=0, x=0;
+        for(size_t i=0; i<placement.length(); i++){
+            char c=placement[i];
+            if(c=='/'){
+                if(x!=8 || ++y>7) return false;
+                x=0;
+            }
+            else if(c>='1' && c<='8'){
+                for(int n=c-'0'; n>0; n--){
+                    if(x>7) return false;
+                    b[y][x++]='.';
+                }
+            }
+            else if(valid_piece(c)){
+                if(x>7) return false;
+                b[y][x++]=c;
+            }
+            else return false;
         }
-        pawn_moves = pawn_pushes | pawn_cross;
-        if(pawn_moves.any()){
-            //print(pawn_moves);
-            //std::cerr << "moves for pawn at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, pawn_moves);
-
+        if(y!=7 || x!=8) return false;
+        if(side!="w" && side!="b") return false;
+        int e=64;
+        if(ep!="-"){
+            if(ep.length()!=2 || !valid_file(ep[0]) || !valid_rank(ep[1])) return false;
+            e=8*('8'-ep[1])+ep[0]-'a';
         }
-        mobility+=pawn_moves.count();
-        attackmap|=pawn_moves;
+        for(y=0; y<8; y++)
+            for(x=0; x<8; x++) a[y][x]=b[y][x];
+        attacks_ready=false;
+        half_move=2*(fullmove-1)+(side=="b" ? 1 : 0);
+        white_can_castle=castle.find_first_of("KQ")!=std::string::npos;
+        black_can_castle=castle.find_first_of("kq")!=std::string::npos;
+        enpassant_square=e;
+        fifty_clock=clock;
+        variation="";
+        recompute_bitboards();
+        context=std::make_shared<SearchContext>();
+        key=compute_key();
+        material_key=compute_material_key();
+        push_key();
+        return true;
     }
 
-    void Board::gen_w_pawn_moves(int y,int x){
-        int index=8*y+x;
-        std::bitset<64> pawn_moves;
-        std::bitset<64> pawn_pushes;
-        std::bitset<64> pawn_cross;
-        if(y>0 && empty.test(index-8)) pawn_pushes.set(index-8);
-        if(y==6 && empty.test(index-8) && empty.test(index-16)) pawn_pushes.set(index-16);
-        if(y>0 && x<7 && black.test(index-7)) pawn_cross.set(index-7);
-        if(y>0 && x>0 && black.test(index-9)) pawn_cross.set(index-9);
-        if(y>0 && x>0 && enpassant_square==index-7){
-            pawn_cross.set(index-7);
-            enpassant_square=64;
+    std::string Board::fen(){
+        std::string s;
+        for(int y=0; y<8; y++){
+            int run=0;
+            for(int x=0; x<8; x++){
+                if(a[y][x]=='.') run++;
+                else{
+                    if(run) s+=static_cast<char>('0'+run);
+                    run=0;
+                    s+=a[y][x];
+                }
+            }
+            if(run) s+=static_cast<char>('0'+run);
+            if(y<7) s+='/';
         }
-        if(y>0 && x<7 && enpassant_square==index-9){
-            pawn_cross.set(index-9);
-            enpassant_square=64;
+        s+=(half_move%2==0) ? " w " : " b ";
+        // only one flag is kept per side, so both wings go together
+        std::string castle;
+        if(white_can_castle) castle+="KQ";
+        if(black_can_castle) castle+="kq";
+        s+=castle.empty() ? "-" : castle;
+        if(enpassant_square<64){
+            s+=' ';
+            s+=static_cast<char>('a'+(enpassant_square&7));
+            s+=static_cast<char>('8'-(enpassant_square>>3));
         }
-        pawn_moves = pawn_pushes | pawn_cross;
-        if(pawn_moves.any()){
-            //print(pawn_moves);
-            //std::cerr << "moves for pawn at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, pawn_moves);
+        else s+=" -";
+        std::ostringstream clocks;
+        clocks << " " << fifty_clock << " " << half_move/2+1;
+        return s+clocks.str();
+    }
 
+    std::string Board::san(int from, int to){
+        char p=a[from>>3][from&7];
+        char up=toupper(p);
+        bool takes=a[to>>3][to&7]!='.' || (up=='P' && (from&7)!=(to&7));
+        std::string s;
+        if(up=='P'){
+            if(takes) s+=static_cast<char>('a'+(from&7));
+        }
+        else{
+            s+=up;
+            // tell apart other pieces of the same kind that reach `to`
+            Board temp_board=*this;
+            temp_board.gen_moves();
+            temp_board.quiet.splice(temp_board.quiet.end(), temp_board.capture);
+            bool other=false, same_file=false, same_rank=false;
+            for(std::list<ChessMove>::iterator i=temp_board.quiet.begin(); i!=temp_board.quiet.end(); i++){
+                int f=(*i).from;
+                if((*i).to!=to || f==from || a[f>>3][f&7]!=p) continue;
+                other=true;
+                if((f&7)==(from&7)) same_file=true;
+                if((f>>3)==(from>>3)) same_rank=true;
+            }
+            if(other && (!same_file || same_rank)) s+=static_cast<char>('a'+(from&7));
+            if(other && same_file) s+=static_cast<char>('8'-(from>>3));
         }
-        mobility+=pawn_moves.count();
-        attackmap|=pawn_moves;
+        if(takes) s+='x';
+        s+=static_cast<char>('a'+(to&7));
+        s+=static_cast<char>('8'-(to>>3));
+        if(up=='P' && ((to>>3)==0 || (to>>3)==7)) s+="=Q";
+        return s;
     }
 
-    void Board::gen_b_knight_moves(int y, int x){
-        std::bitset<64> knight_moves = N[8*y+x] & (~black);
-        if(knight_moves.any()){
-            //print(knight_moves);
-            //std::cerr << "moves for knight at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, knight_moves);
 
-        }
-        mobility+=knight_moves.count();
-        attackmap|=knight_moves;
+    bool Board::valid_file(char f){
+        return f>='a' && f<='h';
     }
 
-    void Board::gen_w_knight_moves(int y, int x){
-        std::bitset<64> knight_moves = N[8*y+x] & (~white);
-        if(knight_moves.any()){
-            //print(knight_moves);
-            //std::cerr << "moves for knight at ("<<y<<", "<<x<<")\n";
-            add_move_from_bitmap(8*y+x, knight_moves);
-
-        }
-        mobility+=knight_moves.count();
-        attackmap|=knight_moves;
+    bool Board::valid_rank(char r){
+        return r>='1' && r<='8';
     }
 
-    void Board::gen_w_king_moves(int y,int x){
-        std::bitset<64> king_moves = K[8*y+x] &(~white);
-        if(king_moves.any()){
-            add_move_from_bitmap(8*y+x, king_moves);
-        }
+    bool Board::valid_piece(char p){
+        return p=='r' || p=='R'
+            || p=='n' || p=='N'
+            || p=='b' || p=='B'
+            || p=='q' || p=='Q'
+            || p=='k' || p=='K'
+            || p=='p' || p=='P';
     }
 
-    void Board::gen_b_king_moves(int y,int x){
-        std::bitset<64> king_moves = K[8*y+x] &(~black);
-        if(king_moves.any()){
-            add_move_from_bitmap(8*y+x, king_moves);
+    template<int SIDE>
+    void Board::gen_pawn_moves(int index, const std::bitset<64> &keep){
+        // pushes towards the other side, captures and en passant, adding
+        // the ones that land in `keep`. for white forward is towards row
+        // 0. both pawns beside a double push can take it en passant.
+        const int ep=enpassant_square;
+        const int forward=SIDE==SIDE_WHITE ? -8 : 8;
+        const int start=SIDE==SIDE_WHITE ? 6 : 1;
+        const std::bitset<64> &enemy=SIDE==SIDE_WHITE ? black : white;
+        int y=index>>3, x=index&7;
+        int ahead=index+forward;
+        std::bitset<64> pawn_moves;
+        if(ahead<0 || ahead>63) return;
+        if(empty.test(ahead)){
+            pawn_moves.set(ahead);
+            if(y==start && empty.test(ahead+forward)) pawn_moves.set(ahead+forward);
         }
+        if(x>0 && (enemy.test(ahead-1) || ep==ahead-1)) pawn_moves.set(ahead-1);
+        if(x<7 && (enemy.test(ahead+1) || ep==ahead+1)) pawn_moves.set(ahead+1);
+        std::bitset<64> moves=pawn_moves & keep;
+        if(moves.any()) add_move_from_bitmap(index, moves, pawn_moves.count());
     }
 
-    void Board::gen_moves(){
-        mobility=0;
-        psq_value=0;
+    template<int SIDE>
+    void Board::generate_captures(){
+        // every piece but the pawns moves to what it attacks that isn't
+        // its own side's, straight off the attack tables. this keeps the
+        // moves onto enemy men; generate_quiets() adds the rest later,
+        // ordered as if both had been generated together.
+        PROFILE(PROF_GEN);
         quiet.clear();
         capture.clear();
         recompute_bitboards();
-        for(int y=0; y<8; y++){
-            for(int x=0; x<8; x++){
-                if(half_move%2==0){
-                    switch(a[y][x]){
-                        case 'R': gen_w_rook_moves(y,x); psq_value+=ROOK_PSQ[8*y+x]; break;
-                        case 'B': gen_w_bishop_moves(y,x); psq_value+=BISHOP_PSQ[8*y+x];break;
-                        case 'Q': gen_w_queen_moves(y,x); psq_value+=QUEEN_PSQ[8*y+x]; break;
-                        case 'P': gen_w_pawn_moves(y,x); psq_value+=PAWN_PSQ[8*y+x]; break;
-                        case 'N': gen_w_knight_moves(y,x); psq_value+=KNIGHT_PSQ[8*y+x]; break;
-                        case 'K': gen_w_king_moves(y,x); psq_value+=KING_PSQ[8*y+x]; break;
-                    }
-                }
-                else{
-                    switch(a[y][x]){
-                        case 'r': gen_b_rook_moves(y,x); psq_value+=ROOK_PSQ[64-8*y+x]; break;
-                        case 'b': gen_b_bishop_moves(y,x); psq_value+=BISHOP_PSQ[64-8*y+x];break;
-                        case 'q': gen_b_queen_moves(y,x); psq_value+=QUEEN_PSQ[64-8*y+x];break;
-                        case 'p': gen_b_pawn_moves(y,x); break;
-                        case 'n': gen_b_knight_moves(y,x); psq_value+=KNIGHT_PSQ[64-8*y+x];break;
-                        case 'k': gen_b_king_moves(y,x);psq_value+=KING_PSQ[64-8*y+x]; break;
-                    }
-                }
+        const AttackInfo &info=attacks();
+        const std::bitset<64> &own=SIDE==SIDE_WHITE ? white : black;
+        const std::bitset<64> &enemy=SIDE==SIDE_WHITE ? black : white;
+        for(int sq=0; sq<64; sq++){
+            if(!own.test(sq)) continue;
+            char p=a[sq>>3][sq&7];
+            if(p=='P' || p=='p') gen_pawn_moves<SIDE>(sq, enemy);
+            else{
+                std::bitset<64> moves=info.piece[sq] & ~own;
+                if((moves & enemy).any()) add_move_from_bitmap(sq, moves & enemy, moves.count());
             }
         }
-        if(half_move%2==0){
-            quiet.sort(bigdumb::sortforwhitequiet);
-            capture.sort(bigdumb::sortforwhitecapture);
+        {
+            PROFILE(PROF_SORT);
+            capture.sort(SIDE==SIDE_WHITE ? bigdumb::sortforwhitecapture : bigdumb::sortforblackcapture);
         }
-        else{
-            quiet.sort(bigdumb::sortforblackquiet);
-            capture.sort(bigdumb::sortforblackcapture);
+    }
+
+    template<int SIDE>
+    void Board::generate_quiets(){
+        // the moves onto empty squares (en passant among them), on the
+        // bitboards generate_captures() left
+        PROFILE(PROF_GEN);
+        quiet.clear();
+        const AttackInfo &info=attacks();
+        const std::bitset<64> &own=SIDE==SIDE_WHITE ? white : black;
+        for(int sq=0; sq<64; sq++){
+            if(!own.test(sq)) continue;
+            char p=a[sq>>3][sq&7];
+            if(p=='P' || p=='p') gen_pawn_moves<SIDE>(sq, empty);
+            else{
+                std::bitset<64> moves=info.piece[sq] & ~own;
+                if((moves & empty).any()) add_move_from_bitmap(sq, moves & empty, moves.count());
+            }
+        }
+        {
+            PROFILE(PROF_SORT);
+            quiet.sort(SIDE==SIDE_WHITE ? bigdumb::sortforwhitequiet : bigdumb::sortforblackquiet);
         }
-        //print_capture();
-        //print_quiet();
+    }
+
+    template<int SIDE>
+    void Board::generate(){
+        generate_captures<SIDE>();
+        generate_quiets<SIDE>();
+    }
+
+    template<int SIDE>
+    bool Board::pseudo_legal(int from, int to){
+        // whether generate() would produce from-to here, without running
+        // it; the table's move and the killers come from other nodes
+        const int enemy=1-SIDE;
+        if(from<0 || from>63 || to<0 || to>63) return false;
+        const AttackInfo &info=attacks();
+        if(!info.men[SIDE].test(from) || info.men[SIDE].test(to)) return false;
+        char p=a[from>>3][from&7];
+        if(p!='P' && p!='p') return info.piece[from].test(to);
+        const int forward=SIDE==SIDE_WHITE ? -8 : 8;
+        int ahead=from+forward;
+        if(ahead<0 || ahead>63) return false;
+        if(to==ahead) return a[to>>3][to&7]=='.';
+        if(to==ahead+forward)
+            return (from>>3)==(SIDE==SIDE_WHITE ? 6 : 1) && a[ahead>>3][ahead&7]=='.' && a[to>>3][to&7]=='.';
+        return info.piece[from].test(to) && (info.men[enemy].test(to) || enpassant_square==to);
+    }
+
+    void Board::gen_moves(){
+        if(half_move%2==0) generate<SIDE_WHITE>();
+        else generate<SIDE_BLACK>();
     }
 
     void Board::print_quiet(){
@@ -752,227 +868,535 @@ namespace bigdumb{
 
     }
 
-    int Board::board_white_value(){
-		int mval=0;
+    template<int SIDE>
+    int Board::material(){
+        // material and piece squares for one side; the tables are
+        // written from white's side, so black reads them upside down
+        int mval=0;
         for(int i=0; i<8; i++){
             for(int j=0; j<8; j++){
-                switch(a[i][j]){
-                    case 'R': mval+=500 + ROOK_PSQ[8*i+j]; break;
-                    case 'N': mval+=320 + KNIGHT_PSQ[8*i+j]; break;
-                    case 'B': mval+=330 + BISHOP_PSQ[8*i+j]; break;
-                    case 'Q': mval+=900 + QUEEN_PSQ[8*i+j]; break;
-                    case 'K': mval+=20000 + KING_PSQ[8*i+j]; break;
-                    case 'P': mval+=100 + PAWN_PSQ[8*i+j]; break;
-					default: break;
+                char p=a[i][j];
+                if(p=='.' || is_white(p)!=(SIDE==SIDE_WHITE)) continue;
+                int sq=SIDE==SIDE_WHITE ? 8*i+j : 8*(7-i)+j;
+                switch(p|0x20){
+                    case 'r': mval+=ROOK_VALUE + ROOK_PSQ[sq]; break;
+                    case 'n': mval+=KNIGHT_VALUE + KNIGHT_PSQ[sq]; break;
+                    case 'b': mval+=BISHOP_VALUE + BISHOP_PSQ[sq]; break;
+                    case 'q': mval+=QUEEN_VALUE + QUEEN_PSQ[sq]; break;
+                    case 'k': mval+=KING_VALUE + KING_PSQ[sq]; break;
+                    case 'p': mval+=PAWN_VALUE + PAWN_PSQ[sq]; break;
                 }
             }
         }
-		return mval;
+        return mval;
     }
-	
-    int Board::board_black_value(){
-		int mval=0;
-        for(int i=0; i<8; i++){
-            for(int j=0; j<8; j++){
-                switch(a[i][j]){
-                    case 'r': mval+=500 + ROOK_PSQ[8*(7-i)+j]; break;
-                    case 'n': mval+=320 + KNIGHT_PSQ[8*(7-i)+j]; break;
-                    case 'b': mval+=330 + BISHOP_PSQ[8*(7-i)+j]; break;
-                    case 'q': mval+=900 + QUEEN_PSQ[8*(7-i)+j]; break;
-                    case 'k': mval+=20000 + KING_PSQ[8*(7-i)+j]; break;
-                    case 'p': mval+=100 + PAWN_PSQ[8*(7-i)+j]; break;
-					default: break;
-                }
+
+    int Board::evaluate(){
+        // white minus black. the material table settles the endings it
+        // knows, and says how much of an advantage the rest keep
+        PROFILE(PROF_EVAL);
+        const MaterialEntry *m=material_entry(material_key);
+        if(m && m->evaluator!=EG_NONE) return endgame(*m);
+        int score;
+        int ply=half_move-context->root_ply;
+        if(USE_NNUE && !context->accumulators.empty() && ply>=0 && ply<=MAX_PLY
+                && !context->accumulators[ply].king_lost){
+            int v=nnue_evaluate(context->accumulators[ply], half_move%2==0);
+            score=half_move%2==0 ? v : -v;
+        }
+        else{
+            const AttackInfo &info=attacks();
+            // a pawn shield matters less as the pieces come off
+            int phase=m ? m->phase : PHASE_MAX;
+            score=material<SIDE_WHITE>() - material<SIDE_BLACK>()
+                + positional<SIDE_WHITE>(info) - positional<SIDE_BLACK>(info)
+                + (pawn_shield<SIDE_WHITE>(info) - pawn_shield<SIDE_BLACK>(info))*phase/PHASE_MAX;
+        }
+        if(m) score=score*m->scale[score>0 ? SIDE_WHITE : SIDE_BLACK]/SCALE_NORMAL;
+        return score;
+    }
+
+    int Board::endgame(const MaterialEntry &m){
+        // a known draw, or a won ending scored so the search finds the
+        // way to convert it: the lone king pushed to the edge (or to a
+        // corner the bishop covers) and the other king brought up
+        if(m.evaluator==EG_DRAW) return 0;
+        const AttackInfo &info=attacks();
+        int strong=m.strong, weak=1-strong;
+        int ks=info.king[strong], kw=info.king[weak];
+        if(ks<0 || kw<0) return 0;
+        // the square colours of the strong side's bishops, a8 being light
+        int colours=0;
+        char bishop=strong==SIDE_WHITE ? 'B' : 'b';
+        for(int sq=0; sq<64; sq++)
+            if(a[sq>>3][sq&7]==bishop) colours|=((sq>>3)+(sq&7))%2==0 ? 1 : 2;
+        // two bishops on one colour, and nothing else, can't mate
+        if(m.evaluator==EG_MOPUP && colours && colours!=3 && material_count(material_key, 6*strong+2)==2
+                && !material_count(material_key, 6*strong+1) && !material_count(material_key, 6*strong+3)
+                && !material_count(material_key, 6*strong+4)) return 0;
+        int x=kw&7, y=kw>>3;
+        int push;
+        if(m.evaluator==EG_KBNK){
+            // a light bishop mates on a8 or h1, a dark one on a1 or h8:
+            // away from the long diagonal between the other two corners,
+            // which has to pull harder than an edge to get there
+            push=2*(colours==1 ? std::abs(x+y-7) : std::abs(x-y));
+        }
+        else{
+            // 0 in the centre, 3 on the edge, on each axis
+            int fx=x<4 ? 3-x : x-4, fy=y<4 ? 3-y : y-4;
+            push=fx+fy;
+        }
+        int close=7-std::max(std::abs((ks&7)-x), std::abs((ks>>3)-y));
+        int score=material<SIDE_WHITE>()-material<SIDE_BLACK>();
+        int bonus=KNOWN_WIN+MOPUP_PUSH*push+MOPUP_CLOSE*close;
+        return strong==SIDE_WHITE ? score+bonus : score-bonus;
+    }
+
+    template<int SIDE>
+    int Board::positional(const AttackInfo &info){
+        // mobility and king safety for one side. one pass over its
+        // pieces scores where they go and what they aim at the squares
+        // around the enemy king.
+        const int enemy=1-SIDE;
+        // squares no enemy pawn covers and no own man stands on
+        std::bitset<64> safe=~(info.men[SIDE] | info.by_type[enemy][0]);
+        std::bitset<64> zone;
+        if(info.king[enemy]>=0){
+            zone=K[info.king[enemy]];
+            zone.set(info.king[enemy]);
+        }
+        int score=0, weight=0, attackers=0;
+        for(int sq=0; sq<64; sq++){
+            if(!info.men[SIDE].test(sq)) continue;
+            int t;
+            switch(a[sq>>3][sq&7]|0x20){
+                case 'n': t=0; break;
+                case 'b': t=1; break;
+                case 'r': t=2; break;
+                case 'q': t=3; break;
+                default: continue;
             }
+            int reach=static_cast<int>((info.piece[sq] & safe).count());
+            int hits=static_cast<int>((info.piece[sq] & zone).count());
+            score+=MOBILITY_WEIGHT[t]*(reach-MOBILITY_BASE[t]);
+            weight+=KING_ATTACK_WEIGHT[t]*hits;
+            attackers+=hits>0;
         }
-		return mval;
+        if(attackers>7) attackers=7;
+        // without a queen it is no attack worth the name
+        if(info.by_type[SIDE][4].any()) score+=weight*KING_DANGER*KING_ATTACKERS[attackers]/100;
+        return score;
     }
 
+    template<int SIDE>
+    int Board::pawn_shield(const AttackInfo &info){
+        // own pawns in front of a king still on its first two ranks
+        int king=info.king[SIDE];
+        if(king<0 || (SIDE==SIDE_WHITE ? king<48 : king>=16)) return 0;
+        std::bitset<64> near=SIDE==SIDE_WHITE ? WHITEPAWNFORK[king] : BLACKPAWNFORK[king];
+        near.set(SIDE==SIDE_WHITE ? king-8 : king+8);
+        std::bitset<64> far=SIDE==SIDE_WHITE ? near>>8 : near<<8;
+        return PAWN_SHIELD[0]*static_cast<int>((near & info.pawns[SIDE]).count())
+            + PAWN_SHIELD[1]*static_cast<int>((far & info.pawns[SIDE]).count());
+    }
 
-    int Board::abmax(int alpha, int beta, int depth){
-		if(depth==ROOT_DEPTH) variation=std::string("");
-		if(depth==0){
-			return board_white_value() - board_black_value();;
+    template<int SIDE>
+    bool Board::better(int x, int y){
+        // whether x is a better score than y for SIDE
+        return SIDE==SIDE_WHITE ? x>y : x<y;
+    }
+
+    template<int SIDE, int NODE>
+    int Board::alphabeta(int alpha, int beta, int depth){
+		// white raises alpha, black lowers beta; `own` is the bound the
+		// side to move improves, and its score once it cuts.
+		const int enemy=1-SIDE, sign=SIDE==SIDE_WHITE ? 1 : -1;
+		int &own=SIDE==SIDE_WHITE ? alpha : beta;
+		int &theirs=SIDE==SIDE_WHITE ? beta : alpha;
+		if(context->stop) return 0;
+		count_node();
+		push_key();
+		int ply=half_move-context->root_ply;
+		if(NODE==NODE_ROOT){
+			variation=std::string("");
+			engine_white=SIDE==SIDE_WHITE;
 		}
 		else{
-			gen_moves();
-			int bestfrom, bestto;
-			int max=INT_MIN;
-			for(std::list<ChessMove>::iterator i=capture.begin(); i!=capture.end(); i++){
-				int from = (*i).from, to = (*i).to;
-				Board temp_board = *this;
-				temp_board.move(from,to);
-				temp_board.half_move++;
-                temp_board.variation += " ";
-                temp_board.variation += static_cast<char>('a'+(from%8));
-                temp_board.variation += static_cast<char>('8'-(from/8));
-                temp_board.variation += static_cast<char>('a'+(to%8));
-                temp_board.variation += static_cast<char>('8'-(to/8));
-				int x = temp_board.abmin(alpha, beta, depth-1);
-				if(x>max) {
-					max=x;
-					bestfrom=from;
-					bestto=to;
+			// draws by rule, and by the material table, cost nothing
+			if(is_draw()) return draw_value();
+			const MaterialEntry *m=material_entry(material_key);
+			if(m && m->evaluator==EG_DRAW) return draw_value();
+			// no mate from here can beat one already found nearer the
+			// root: the window shrinks to what is still possible, mating
+			// on the next ply at best and mated on this one at worst
+			int best_case=MATE_SCORE-ply-1, worst_case=-(MATE_SCORE-ply);
+			if(better<SIDE>(sign*worst_case, own)) own=sign*worst_case;
+			if(better<SIDE>(theirs, sign*best_case)) theirs=sign*best_case;
+			if(alpha>=beta) return own;
+		}
+		// a check is searched a ply deeper, but only up to twice the
+		// root's depth from it, so a run of checks can't explode
+		bool check=in_check(SIDE==SIDE_WHITE);
+		if(check && NODE!=NODE_ROOT && ply<2*context->root_depth && ply+depth<MAX_PLY-CAPTURE_DEPTH){
+			depth++;
+			context->stats.check_extensions++;
+		}
+		if(depth==0) return quiesce<SIDE>(alpha, beta, CAPTURE_DEPTH);
+		TTEntry entry;
+		if(probe_tt(depth, alpha, beta, entry)) return entry.score;
+		int alpha0=alpha, beta0=beta;
+		bool futile=false;
+		if(frontier<SIDE, NODE>(depth)){
+			int eval=evaluate();
+			if(bounded(theirs) && !better<SIDE>(theirs, eval-sign*context->rfp_margin*depth)){
+				context->stats.rfp_pruned++;
+				return eval;
+			}
+			if(depth<=2 && bounded(own) && better<SIDE>(own, eval+sign*context->razor_margin*depth)){
+				int x=quiesce<SIDE>(alpha, beta, CAPTURE_DEPTH);
+				if(!better<SIDE>(x, own)){
+					context->stats.razored++;
+					return x;
 				}
-				if(x>alpha) alpha=x;
-				if(alpha>=beta) return alpha;
 			}
-			for(std::list<ChessMove>::iterator i=quiet.begin(); i!=quiet.end(); i++){
-				int from = (*i).from, to=(*i).to;
-				Board temp_board = *this;
-				temp_board.move(from,to);
-				temp_board.half_move++;
-                temp_board.variation += " ";
-                temp_board.variation += static_cast<char>('a'+(from%8));
-                temp_board.variation += static_cast<char>('8'-(from/8));
-                temp_board.variation += static_cast<char>('a'+(to%8));
-                temp_board.variation += static_cast<char>('8'-(to/8));
-				int x = temp_board.abmin(alpha, beta, depth-1);
-				if(x>max) {
-					max=x;
-					bestfrom=from;
-					bestto=to;
+			futile=bounded(own) && !better<SIDE>(eval+sign*context->futility_margin*depth, own);
+		}
+		int bestfrom=-1, bestto=-1;
+		int best=SIDE==SIDE_WHITE ? INT_MIN : INT_MAX;
+		int searched=0, legal=0;
+		// the single moves tried ahead of their generated stage
+		ChessMove tried[3];
+		int n_tried=0;
+		for(int stage=STAGE_HASH; stage<=STAGE_QUIET; stage++){
+			if(stage==STAGE_HASH){
+				capture.clear();
+				quiet.clear();
+				if(entry.from>=0 && pseudo_legal<SIDE>(entry.from, entry.to)){
+					tried[n_tried].from=entry.from;
+					tried[n_tried].to=entry.to;
+					capture.push_back(tried[n_tried++]);
 				}
-				if(x>alpha) alpha=x;
-				if(alpha>=beta) return alpha;
 			}
-
-			if(depth==ROOT_DEPTH){
-				move(bestfrom, bestto);
-				half_move++;
-				print_board();
-				std::cout << "move "<<static_cast<char>('a'+(bestfrom%8))
-						  << static_cast<char>('8'-(bestfrom/8))
-						  << static_cast<char>('a'+(bestto%8))
-						  << static_cast<char>('8'-(bestto/8)) << std::endl;
+			else if(stage==STAGE_CAPTURE) generate_captures<SIDE>();
+			else if(stage==STAGE_KILLER){
+				for(int k=0; k<2 && ply>=0 && ply<MAX_PLY; k++){
+					const ChessMove &killer=context->killers[ply][k];
+					if(killer.from<0 || a[killer.to>>3][killer.to&7]!='.') continue;
+					if(n_tried && tried[0].from==killer.from && tried[0].to==killer.to) continue;
+					if(!pseudo_legal<SIDE>(killer.from, killer.to)) continue;
+					tried[n_tried]=killer;
+					quiet.push_back(tried[n_tried++]);
+				}
 			}
-			else return max;
-		}
-    }
-	
-    int Board::qwhite(int alpha, int beta){
-		gen_moves();
-		if(capture.empty()){
-			return board_white_value() - board_black_value();;
-		}
-		else{
-			int bestfrom, bestto;
-			int max=INT_MIN;
-			for(std::list<ChessMove>::iterator i=capture.begin(); i!=capture.end(); i++){
+			else generate_quiets<SIDE>();
+			std::list<ChessMove> &moves=stage<STAGE_KILLER ? capture : quiet;
+			for(std::list<ChessMove>::iterator i=moves.begin(); i!=moves.end(); i++){
 				int from = (*i).from, to = (*i).to;
+				if(NODE==NODE_ROOT && excluded(from, to)) continue;
+				if(stage==STAGE_CAPTURE || stage==STAGE_QUIET){
+					bool again=false;
+					for(int k=0; k<n_tried; k++) again|=tried[k].from==from && tried[k].to==to;
+					if(again) continue;
+				}
+				PROFILE(PROF_COPY);
 				Board temp_board = *this;
+				PROFILE_END();
 				temp_board.move(from,to);
+				// the child needs the attack tables anyway, so a move
+				// into check costs little to throw out
+				if(temp_board.in_check(SIDE==SIDE_WHITE)) continue;
+				legal++;
 				temp_board.half_move++;
                 temp_board.variation += " ";
                 temp_board.variation += static_cast<char>('a'+(from%8));
                 temp_board.variation += static_cast<char>('8'-(from/8));
                 temp_board.variation += static_cast<char>('a'+(to%8));
                 temp_board.variation += static_cast<char>('8'-(to/8));
-				int x = temp_board.qblack(alpha, beta);
-				if(x>max) {
-					max=x;
+				// quiet moves that don't check or promote
+				if(stage>=STAGE_KILLER && futile && searched>0 && !temp_board.in_check(enemy==SIDE_WHITE)
+				   && (SIDE==SIDE_WHITE ? to>=8 : to<56)){
+					context->stats.futility_pruned++;
+					continue;
+				}
+				TRACE(context, TRACE_ENTER, depth-1, from, to, alpha, beta, 0);
+				// the first move of a PV node is on the PV too. the rest
+				// only have to show, on a null window, that they are no
+				// better; one that is gets searched again as PV, so the
+				// move that ends up best was never pruned
+				int x;
+				if(NODE==NODE_NONPV) x=temp_board.alphabeta<enemy, NODE_NONPV>(alpha, beta, depth-1);
+				else if(searched==0) x=temp_board.alphabeta<enemy, NODE_PV>(alpha, beta, depth-1);
+				else{
+					x=SIDE==SIDE_WHITE
+						? temp_board.alphabeta<enemy, NODE_NONPV>(alpha, alpha+1, depth-1)
+						: temp_board.alphabeta<enemy, NODE_NONPV>(beta-1, beta, depth-1);
+					if(x>alpha && x<beta) x=temp_board.alphabeta<enemy, NODE_PV>(alpha, beta, depth-1);
+				}
+				TRACE(context, TRACE_EXIT, depth-1, from, to, alpha, beta, x);
+				searched++;
+				if(better<SIDE>(x, best)){
+					best=x;
 					bestfrom=from;
 					bestto=to;
 				}
-				if(x>alpha) alpha=x;
-				if(alpha>=beta) return alpha;
+				if(better<SIDE>(x, own)) own=x;
+				if(alpha>=beta){
+					count_cutoff(searched);
+					if(stage==STAGE_KILLER) context->stats.killer_cutoffs++;
+					if(stage<STAGE_QUIET) context->stats.early_cutoffs++;
+					if(a[to>>3][to&7]=='.') add_killer(from, to);
+					store_tt(depth, own, alpha0, beta0, from, to);
+					return own;
+				}
 			}
-			return max;
 		}
-    }
-	
-    int Board::qblack(int alpha, int beta){
-		gen_moves();
-		if(capture.empty()){
-			return board_black_value() - board_white_value();;
+		if(!legal){
+			// mated, or stalemate; the root has no move to leave
+			best=check ? -sign*(MATE_SCORE-ply) : draw_value();
+			if(NODE==NODE_ROOT) context->best.from=context->best.to=-1;
+			return best;
 		}
-		else{
-			int bestfrom, bestto;
-			int min=INT_MAX;
-			for(std::list<ChessMove>::iterator i=capture.begin(); i!=capture.end(); i++){
-				int from = (*i).from, to = (*i).to;
-				Board temp_board = *this;
-				temp_board.move(from,to);
-				temp_board.half_move++;
-                temp_board.variation += " ";
-                temp_board.variation += static_cast<char>('a'+(from%8));
-                temp_board.variation += static_cast<char>('8'-(from/8));
-                temp_board.variation += static_cast<char>('a'+(to%8));
-                temp_board.variation += static_cast<char>('8'-(to/8));
-				int x = temp_board.qwhite(alpha, beta);
-				if(x<min) {
-					min=x;
-					bestfrom=from;
-					bestto=to;
-				}
-				if(x<beta) beta=x;
-				if(alpha>=beta) return beta;
-			}
-			return min;
+		if(NODE==NODE_ROOT){
+			context->best.from=bestfrom;
+			context->best.to=bestto;
 		}
+		store_tt(depth, best, alpha0, beta0, bestfrom, bestto);
+		return best;
     }
-	
+
+    int Board::abmax(int alpha, int beta, int depth){
+        // the root for white to move; below it the templates call
+        // each other
+        return alphabeta<SIDE_WHITE, NODE_ROOT>(alpha, beta, depth);
+    }
+
     int Board::abmin(int alpha, int beta, int depth){
-		if(depth==ROOT_DEPTH) variation=std::string("");
-		if(depth==0){
-			return board_black_value() - board_white_value();;
-		}
-		else{
-			gen_moves();
-			int bestfrom, bestto;
-			int min=INT_MAX;
-			for(std::list<ChessMove>::iterator i=capture.begin(); i!=capture.end(); i++){
-				int from = (*i).from, to = (*i).to;
-				Board temp_board = *this;
-				temp_board.move(from,to);
-				temp_board.half_move++;
-                temp_board.variation += " ";
-                temp_board.variation += static_cast<char>('a'+(from%8));
-                temp_board.variation += static_cast<char>('8'-(from/8));
-                temp_board.variation += static_cast<char>('a'+(to%8));
-                temp_board.variation += static_cast<char>('8'-(to/8));
-				int x = temp_board.abmax(alpha, beta, depth-1);
-				if(x<min) {
-					min=x;
-					bestfrom=from;
-					bestto=to;
-				}
-				if(x<beta) beta=x;
-				if(alpha>=beta) return beta;
-			}
-			for(std::list<ChessMove>::iterator i=quiet.begin(); i!=quiet.end(); i++){
-				int from = (*i).from, to=(*i).to;
-				Board temp_board = *this;
-				temp_board.move(from,to);
-				temp_board.half_move++;
-                temp_board.variation += " ";
-                temp_board.variation += static_cast<char>('a'+(from%8));
-                temp_board.variation += static_cast<char>('8'-(from/8));
-                temp_board.variation += static_cast<char>('a'+(to%8));
-                temp_board.variation += static_cast<char>('8'-(to/8));
-				int x = temp_board.abmax(alpha, beta, depth-1);
-				if(x<min) {
-					min=x;
-					bestfrom=from;
-					bestto=to;
-				}
-				if(x<beta) beta=x;
-				if(alpha>=beta) return beta;
-			}
+        return alphabeta<SIDE_BLACK, NODE_ROOT>(alpha, beta, depth);
+    }
+	
+    int Board::search(int depth){
+        // searches the side to move to `depth`, leaving the
+        // chosen move in context->best.
+        PROFILE(PROF_SEARCH);
+        context->root_depth=depth;
+        context->root_ply=half_move;
+        context->clear_killers();
+        if(USE_NNUE){
+            if(context->accumulators.empty()) context->accumulators.resize(MAX_PLY+1);
+            nnue_refresh(context->accumulators[0], a);
+        }
+        std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+        int score;
+        TRACE(context, TRACE_ITER_BEGIN, depth, 0, 0, INT_MIN, INT_MAX, 0);
+        if(half_move%2==0) score=abmax(INT_MIN, INT_MAX, depth);
+        else score=abmin(INT_MIN, INT_MAX, depth);
+        TRACE(context, TRACE_ITER_END, depth, context->best.from, context->best.to, INT_MIN, INT_MAX, score);
+        if(depth>0 && depth<MAX_PLY){
+            context->stats.iteration_ms[depth]+=std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now()-start).count();
+            if(depth>context->stats.max_depth) context->stats.max_depth=depth;
+        }
+        return score;
+    }
 
-			if(depth==ROOT_DEPTH){
-				move(bestfrom, bestto);
-				half_move++;
-				print_board();
-				std::cout << "move "<<static_cast<char>('a'+(bestfrom%8))
-						  << static_cast<char>('8'-(bestfrom/8))
-						  << static_cast<char>('a'+(bestto%8))
-						  << static_cast<char>('8'-(bestto/8)) << std::endl;
+    std::string Board::think(int depth, int movetime){
+        // picks a move, plays it on this board and returns it, or ""
+        // when there is none. with a movetime (ms) the search deepens up
+        // to `depth` and keeps the last iteration that finished in time;
+        // without one it goes straight to `depth`.
+        context->stats.clear();
+        int ply=half_move;
+        unsigned long long root_key=key;
+#ifdef SEARCH_TRACE
+        if(!TRACE_FILE.empty()){
+            if(!context->tracer) context->tracer=std::make_shared<Tracer>(TRACE_RECORDS);
+            context->tracer->begin();
+        }
+#endif
+        // a position an earlier game searched at least as deep is played
+        // from the learning file, unless its move walks into a repetition;
+        // a shallower result still puts the move first
+        LearnRecord learned;
+        bool instant=false;
+        if(!LEARN_FILE.empty() && LEARN.probe(key, learned)){
+            std::list<ChessMove> moves=learned.depth>=depth ? legal_moves() : std::list<ChessMove>();
+            for(std::list<ChessMove>::iterator i=moves.begin(); i!=moves.end(); i++){
+                if((*i).from!=learned.from || (*i).to!=learned.to) continue;
+                Board temp_board=*this;
+                temp_board.move(learned.from, learned.to);
+                temp_board.half_move++;
+                instant=!temp_board.is_draw();
+            }
+            if(!instant) context->tt->store(key, learned.score, learned.depth, TT_EXACT, learned.from, learned.to);
+        }
+        int score;
+        int reached=depth;
+        if(instant){
+            score=learned.score;
+            reached=learned.depth;
+            context->best.from=learned.from;
+            context->best.to=learned.to;
+            LOG_INFO("learned move at depth " << reached);
+        }
+        else if(movetime<=0) score=search(depth);
+        else{
+            std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+            ChessMove best;
+            score=search(1);
+            best=context->best;
+            reached=1;
+            context->deadline=start+std::chrono::milliseconds(movetime);
+            context->timed=true;
+            // a mate found within the depth searched can't get any
+            // shorter, so there is no point going deeper
+            for(int d=2; d<=depth && d<MAX_PLY && (mate_in(score)<0 || mate_in(score)>reached); d++){
+                int x=search(d);
+                if(context->stop) break;
+                score=x;
+                best=context->best;
+                reached=d;
+            }
+            context->timed=false;
+            context->stop=false;
+            context->best=best;
+        }
+        if(context->best.from<0){
+            // mated or stalemated, nothing to play
+            LOG_INFO("no legal move, score " << score);
+            return "";
+        }
+        if(!LEARN_FILE.empty() && !instant) LEARN.record(root_key, score, reached, context->best.from, context->best.to);
+        std::string played=coord(context->best.from, context->best.to);
+        move(played);
+        LOG_INFO("played " << played << " score " << score << " nodes " << context->stats.nodes);
+#ifdef HOT_PROFILE
+        // a line a call, the table is too wide for one
+        std::vector<std::string> profile=PROFILE_TABLE.report();
+        for(size_t i=0; i<profile.size(); i++) LOG_INFO(profile[i]);
+        PROFILE_TABLE.clear();
+#endif
+        LOG_DEBUG(board_string());
+        if(!TELEMETRY_FILE.empty()){
+            std::ostringstream line;
+            line << "{\"ply\":" << ply << ",\"move\":\"" << played << "\",\"depth\":" << reached
+                 << ",\"score\":" << score << "," << context->stats.json() << "}";
+            append_telemetry(line.str());
+        }
+        if(context->tracer) context->tracer->flush(TRACE_FILE, ply, context->best.from, context->best.to);
+        return played;
+    }
+
+    template<int SIDE>
+    int Board::quiesce(int alpha, int beta, int depth){
+		// captures only, until the position is quiet or CAPTURE_DEPTH
+		// runs out. the side to move can always stand pat. a call at
+		// full depth comes from a node that has been counted already.
+		const int enemy=1-SIDE;
+		int &own=SIDE==SIDE_WHITE ? alpha : beta;
+		int &theirs=SIDE==SIDE_WHITE ? beta : alpha;
+		if(context->stop) return 0;
+		if(depth<CAPTURE_DEPTH) count_node();
+		context->stats.qnodes++;
+		int stand=evaluate();
+		if(!better<SIDE>(theirs, stand) || depth==0) return stand;
+		if(better<SIDE>(stand, own)) own=stand;
+		generate_captures<SIDE>();
+		int best=stand;
+		const std::bitset<64> &defended=attacks().all[enemy];
+		for(std::list<ChessMove>::iterator i=capture.begin(); i!=capture.end(); i++){
+			int from = (*i).from, to = (*i).to;
+			// a defended piece taken with a bigger one loses material
+			// as soon as it is taken back. the first capture of the
+			// sequence is always tried, so a real threat isn't missed.
+			// values are signed by colour: white's positive.
+			int attacker=SIDE==SIDE_WHITE ? (*i).attacker : -(*i).attacker;
+			int victim=SIDE==SIDE_WHITE ? -(*i).capture : (*i).capture;
+			if(depth<CAPTURE_DEPTH && attacker>victim && victim!=1000 && defended.test(to)){
+				context->stats.bad_captures++;
+				continue;
 			}
-			else return min;
+			PROFILE(PROF_COPY);
+			Board temp_board = *this;
+			PROFILE_END();
+			temp_board.move(from,to);
+			if(temp_board.in_check(SIDE==SIDE_WHITE)) continue;
+			temp_board.half_move++;
+			int x = temp_board.quiesce<enemy>(alpha, beta, depth-1);
+			if(better<SIDE>(x, best)) best=x;
+			if(better<SIDE>(x, own)) own=x;
+			if(alpha>=beta) return own;
 		}
+		return best;
+    }
+
+    template<int SIDE, int NODE>
+    bool Board::frontier(int depth){
+        // whether this node may be pruned on its static score: close to
+        // the leaves, off the principal variation and not in check.
+        // each rule also wants the bound it compares with to be clear
+        // of mate scores, see bounded().
+        if(NODE!=NODE_NONPV || depth>FRONTIER_DEPTH) return false;
+        return !in_check(SIDE==SIDE_WHITE);
+    }
+
+    bool Board::bounded(int score){
+        return score>-MATE_BOUND && score<MATE_BOUND;
+    }
+
+    bool Board::attacked(int sq, bool by_white){
+        return attacks().all[by_white ? SIDE_WHITE : SIDE_BLACK].test(sq);
+    }
+
+    bool Board::in_check(bool white){
+        const AttackInfo &info=attacks();
+        int king=info.king[white ? SIDE_WHITE : SIDE_BLACK];
+        // no king at all: it was taken, which is worse than check
+        if(king<0) return true;
+        return info.all[white ? SIDE_BLACK : SIDE_WHITE].test(king);
+    }
+
+    const AttackInfo &Board::attacks(){
+        // the search's move(int,int) leaves the bitboards stale, so the
+        // tables are built from the board array
+        if(!attacks_ready){
+            PROFILE(PROF_ATTACKS);
+            attack_info.compute(a);
+            attacks_ready=true;
+        }
+        return attack_info;
+    }
+
+    bool Board::legal(int from, int to){
+        bool white=is_white(a[from>>3][from&7]);
+        Board temp_board=*this;
+        temp_board.move(from,to);
+        return !temp_board.in_check(white);
+    }
+
+    std::list<ChessMove> Board::legal_moves(){
+        Board temp_board=*this;
+        temp_board.gen_moves();
+        std::list<ChessMove> moves;
+        std::list<ChessMove>::iterator i;
+        for(i=temp_board.capture.begin(); i!=temp_board.capture.end(); i++)
+            if(legal((*i).from, (*i).to)) moves.push_back(*i);
+        for(i=temp_board.quiet.begin(); i!=temp_board.quiet.end(); i++)
+            if(legal((*i).from, (*i).to)) moves.push_back(*i);
+        return moves;
+    }
+
+    std::string Board::coord(int from, int to){
+        // the move as xboard wants it, promotions always to a queen
+        std::string s;
+        s += static_cast<char>('a'+(from%8));
+        s += static_cast<char>('8'-(from/8));
+        s += static_cast<char>('a'+(to%8));
+        s += static_cast<char>('8'-(to/8));
+        char p=a[from>>3][from&7];
+        if((p=='P' && to<8) || (p=='p' && to>=56)) s+='q';
+        return s;
     }
-	
 
     bool Board::is_white(char p){
         return (p=='P' || p=='B' || p=='N' || p=='R' || p=='Q' || p=='K');
@@ -981,10 +1405,13 @@ namespace bigdumb{
         return (p=='p' || p=='b' || p=='n' || p=='r' || p=='q' || p=='k');
     }
 
-    void Board::add_move_from_bitmap(int s_from, std::bitset<64> bitmap){
+    void Board::add_move_from_bitmap(int s_from, std::bitset<64> bitmap, int mobility){
+        // mobility is what the quiet moves sort on, the size of bitmap
+        // unless the caller has only passed part of the piece's moves
+        PROFILE(PROF_ADD_MOVES);
         ChessMove temp;
         temp.from=s_from;
-        temp._mobility_=bitmap.count();
+        temp._mobility_=mobility<0 ? bitmap.count() : mobility;
         char def=a[s_from>>3][s_from&7];
         if(def=='r') temp.attacker=-5;
         if(def=='n') temp.attacker=-3;
@@ -1029,3 +1456,6 @@ namespace bigdumb{
         }
     }
 }
+
+#define _board_h
+#endif
@@ -0,0 +1,165 @@
+#ifndef _epd_h
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.h"
+
+namespace bigdumb{
+    class EpdPosition{
+        public:
+            std::string fen;
+            std::string id;
+            std::vector<std::string> bm;
+            std::vector<std::string> am;
+            // filled in by the runner
+            bool solved;
+            double solved_at;
+            SearchStats stats;
+            std::string played;
+    };
+
+    std::string strip_san(std::string m){
+        // "Nf3+", "Qxh7#!" and friends compare as the bare move
+        while(!m.empty() && (m[m.length()-1]=='+' || m[m.length()-1]=='#'
+                || m[m.length()-1]=='!' || m[m.length()-1]=='?'))
+            m.erase(m.length()-1);
+        return m;
+    }
+
+    bool parse_epd(std::string line, EpdPosition &pos){
+        std::istringstream in(line);
+        std::string placement, side, castle, ep;
+        if(!(in >> placement >> side >> castle >> ep)) return false;
+        pos.fen=placement+" "+side+" "+castle+" "+ep;
+        pos.id="";
+        pos.bm.clear();
+        pos.am.clear();
+        std::string rest, op;
+        std::getline(in, rest);
+        std::istringstream ops(rest);
+        while(std::getline(ops, op, ';')){
+            std::istringstream words(op);
+            std::string opcode, operand;
+            if(!(words >> opcode)) continue;
+            if(opcode=="bm" || opcode=="am"){
+                while(words >> operand){
+                    if(opcode=="bm") pos.bm.push_back(strip_san(operand));
+                    else pos.am.push_back(strip_san(operand));
+                }
+            }
+            else if(opcode=="id"){
+                std::getline(words, operand);
+                size_t l=operand.find('"'), r=operand.rfind('"');
+                if(l!=std::string::npos && r>l) pos.id=operand.substr(l+1, r-l-1);
+                else pos.id=operand;
+            }
+        }
+        return true;
+    }
+
+    bool epd_satisfied(const EpdPosition &pos, std::string san){
+        for(size_t i=0; i<pos.am.size(); i++)
+            if(pos.am[i]==san) return false;
+        if(pos.bm.empty()) return true;
+        for(size_t i=0; i<pos.bm.size(); i++)
+            if(pos.bm[i]==san) return true;
+        return false;
+    }
+
+    void solve_epd(EpdPosition &pos, int depth){
+        // deepens one ply at a time; the time to solution is when the
+        // answer was first found and then kept to the last iteration.
+        Board board;
+        pos.solved=false;
+        pos.solved_at=-1;
+        pos.stats.clear();
+        if(!board.set_fen(pos.fen)) return;
+        std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+        for(int d=1; d<=depth; d++){
+            board.search(d);
+            // mate or stalemate on the board: nothing to play, so unsolved
+            if(board.context->best.from<0){
+                pos.played="(none)";
+                pos.solved=false;
+                break;
+            }
+            pos.played=board.san(board.context->best.from, board.context->best.to);
+            double elapsed=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            if(epd_satisfied(pos, pos.played)){
+                if(!pos.solved) pos.solved_at=elapsed;
+                pos.solved=true;
+            }
+            else pos.solved=false;
+        }
+        pos.stats=board.context->stats;
+        if(!pos.solved) pos.solved_at=-1;
+    }
+
+    void run_epd(std::string file, int depth, int threads){
+        std::ifstream in(file.c_str());
+        if(!in){
+            std::cerr << "error: can't open epd file " << file << "\n";
+            kill_engine();
+        }
+        std::vector<EpdPosition> suite;
+        std::string line;
+        while(std::getline(in, line)){
+            EpdPosition pos;
+            if(parse_epd(line, pos)){
+                if(pos.id.empty()){
+                    std::ostringstream id;
+                    id << "#" << suite.size()+1;
+                    pos.id=id.str();
+                }
+                suite.push_back(pos);
+            }
+        }
+        if(threads<1) threads=1;
+        // the threads share the table, so only a one thread run is
+        // repeatable, and only from an empty one
+        TT.clear();
+        std::atomic<int> next(0);
+        std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for(int t=0; t<threads; t++){
+            pool.push_back(std::thread([&](){
+                for(int i=next++; i<(int)suite.size(); i=next++) solve_epd(suite[i], depth);
+            }));
+        }
+        for(size_t t=0; t<pool.size(); t++) pool[t].join();
+        double elapsed=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+        int solved=0;
+        SearchStats total;
+        double tts=0;
+        for(size_t i=0; i<suite.size(); i++){
+            EpdPosition &pos=suite[i];
+            total.merge(pos.stats);
+            std::cout << pos.id << "\t" << (pos.solved ? "solved" : "FAILED")
+                      << "\t" << pos.played;
+            if(pos.solved){
+                solved++;
+                tts+=pos.solved_at;
+                std::cout << "\t" << pos.solved_at << "s";
+            }
+            std::cout << "\n";
+        }
+        std::cout << "solved " << solved << "/" << suite.size()
+                  << " at depth " << depth << " on " << threads << " threads\n";
+        if(solved) std::cout << "mean time to solution " << tts/solved << "s\n";
+        std::cout << "first move cutoffs " << 100*total.fail_high_first_rate() << "%\n";
+        std::cout << "table hits " << (total.tt_probes ? 100.0*total.tt_hits/total.tt_probes : 0)
+                  << "%, cutoffs " << total.tt_cutoffs << "\n";
+        std::cout << "nodes " << total.nodes << ", time " << elapsed << "s, nps "
+                  << static_cast<long long>(elapsed>0 ? total.nodes/elapsed : 0) << std::endl;
+    }
+}
+
+#define _epd_h
+#endif
@@ -0,0 +1,208 @@
+#ifndef _learn_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "mapfile.h"
+#include "tt.h"
+
+// search results that outlive the game and the process. switched on
+// with `-learn <file>`: after each move the engine adds the root's
+// score, depth and move, and a position it has already searched at
+// least as deep is played from the file without a search.
+//
+// the file is a header followed by 16 byte records, appended as they
+// come in the byte order of the machine that wrote them. a later record
+// for a position replaces an earlier one that is no deeper, so the file
+// is rewritten, one record per position, once half of it is stale.
+
+#define LEARN_MAGIC 0x4e524c42u
+#define LEARN_VERSION 1
+
+std::string LEARN_FILE = "";
+// results shallower than this aren't worth a record
+int LEARN_DEPTH = 4;
+
+namespace bigdumb{
+    class LearnHeader{
+        public:
+            uint32_t magic;
+            uint32_t version;
+    };
+
+    class LearnRecord{
+        public:
+            uint64_t key;
+            int32_t score;
+            uint8_t depth;
+            uint8_t from;
+            uint8_t to;
+            uint8_t unused;
+    };
+
+    class LearningStore{
+        public:
+            std::string path;
+            std::unordered_map<uint64_t, LearnRecord> entries;
+            // records in the file, stale ones included
+            size_t records;
+            // added while a rewrite runs, to go at the end of the new file
+            std::vector<LearnRecord> late;
+            // after a rewrite fails, the records to wait for before the
+            // next try
+            size_t retry;
+            bool compacting;
+            std::thread compactor;
+            std::mutex lock;
+
+            LearningStore(){
+                records=0;
+                retry=0;
+                compacting=false;
+            }
+
+            ~LearningStore(){
+                if(compactor.joinable()) compactor.join();
+            }
+
+            bool open(const std::string &file){
+                // reads what is there, a missing file is an empty store
+                std::lock_guard<std::mutex> guard(lock);
+                path=file;
+                entries.clear();
+                records=0;
+                MappedFile mapped;
+                if(!mapped.open(file.c_str())) return true;
+                if(mapped.size<sizeof(LearnHeader)) return false;
+                const LearnHeader *h=reinterpret_cast<const LearnHeader *>(mapped.data);
+                if(h->magic!=LEARN_MAGIC || h->version!=LEARN_VERSION) return false;
+                const LearnRecord *r=reinterpret_cast<const LearnRecord *>(mapped.data+sizeof(LearnHeader));
+                // a record cut short by a crash is ignored
+                records=(mapped.size-sizeof(LearnHeader))/sizeof(LearnRecord);
+                for(size_t i=0; i<records; i++) keep(r[i]);
+                mapped.close();
+                stale();
+                return true;
+            }
+
+            bool probe(uint64_t key, LearnRecord &r){
+                std::lock_guard<std::mutex> guard(lock);
+                std::unordered_map<uint64_t, LearnRecord>::iterator i=entries.find(key);
+                if(i==entries.end()) return false;
+                r=i->second;
+                return true;
+            }
+
+            void seed(TranspositionTable &tt){
+                // every learned root as an exact result, so the search
+                // cuts on them wherever they come up
+                std::lock_guard<std::mutex> guard(lock);
+                for(std::unordered_map<uint64_t, LearnRecord>::iterator i=entries.begin(); i!=entries.end(); i++)
+                    tt.store(i->first, i->second.score, i->second.depth, TT_EXACT, i->second.from, i->second.to);
+            }
+
+            void record(uint64_t key, int score, int depth, int from, int to){
+                if(path.empty() || depth<LEARN_DEPTH || from<0) return;
+                LearnRecord r;
+                r.key=key;
+                r.score=score;
+                r.depth=static_cast<uint8_t>(depth<255 ? depth : 255);
+                r.from=static_cast<uint8_t>(from);
+                r.to=static_cast<uint8_t>(to);
+                r.unused=0;
+                // sessions in the server finish moves on several threads
+                std::lock_guard<std::mutex> guard(lock);
+                if(!keep(r)) return;
+                if(!append(path, &r, 1)) return;
+                records++;
+                if(compacting) late.push_back(r);
+                else stale();
+            }
+
+            void stale(){
+                // called with the lock held
+                if(compacting || records<1024 || records<retry || records<=2*entries.size()) return;
+                if(compactor.joinable()) compactor.join();
+                compacting=true;
+                compactor=std::thread(&LearningStore::compact, this);
+            }
+
+            bool keep(const LearnRecord &r){
+                // a result no deeper than the one held is dropped
+                std::unordered_map<uint64_t, LearnRecord>::iterator i=entries.find(r.key);
+                if(i!=entries.end() && i->second.depth>r.depth) return false;
+                entries[r.key]=r;
+                return true;
+            }
+
+            static bool append(const std::string &file, const LearnRecord *r, size_t n){
+                FILE *out=fopen(file.c_str(), "ab");
+                if(!out) return false;
+                fseek(out, 0, SEEK_END);
+                if(ftell(out)==0){
+                    LearnHeader h;
+                    h.magic=LEARN_MAGIC;
+                    h.version=LEARN_VERSION;
+                    fwrite(&h, sizeof(h), 1, out);
+                }
+                if(n) fwrite(r, sizeof(LearnRecord), n, out);
+                fclose(out);
+                return true;
+            }
+
+            static bool replace(const std::string &from, const std::string &to){
+#ifdef _WIN32
+                // rename won't overwrite here, so the old file is moved
+                // aside and only deleted once the new one is in its place
+                std::string old=to+".old";
+                remove(old.c_str());
+                if(rename(to.c_str(), old.c_str())!=0) return false;
+                if(rename(from.c_str(), to.c_str())!=0){
+                    rename(old.c_str(), to.c_str());
+                    return false;
+                }
+                remove(old.c_str());
+                return true;
+#else
+                return rename(from.c_str(), to.c_str())==0;
+#endif
+            }
+
+            void compact(){
+                // writes the live records to a new file off the search
+                // threads, then swaps it in with whatever came in since
+                std::vector<LearnRecord> live;
+                std::string tmp;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    live.reserve(entries.size());
+                    for(std::unordered_map<uint64_t, LearnRecord>::iterator i=entries.begin(); i!=entries.end(); i++)
+                        live.push_back(i->second);
+                    tmp=path+".tmp";
+                }
+                remove(tmp.c_str());
+                bool ok=append(tmp, live.empty() ? NULL : &live[0], live.size());
+                std::lock_guard<std::mutex> guard(lock);
+                if(ok) ok=append(tmp, late.empty() ? NULL : &late[0], late.size());
+                // the old file stays until the new one has replaced it,
+                // and it already has the late records
+                if(ok) ok=replace(tmp, path);
+                if(ok) records=live.size()+late.size();
+                else{
+                    remove(tmp.c_str());
+                    retry=2*records;
+                }
+                late.clear();
+                compacting=false;
+            }
+    };
+
+    LearningStore LEARN;
+}
+
+#define _learn_h
+#endif
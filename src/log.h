@@ -0,0 +1,156 @@
+#ifndef _log_h
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+// pick with -DLOG_LEVEL=... at compile time. messages above the level
+// are not compiled in at all, arguments included.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_SLOTS 1024
+#define LOG_TEXT 256
+
+namespace bigdumb{
+    class LogSlot{
+        public:
+            std::atomic<size_t> seq;
+            int len;
+            char text[LOG_TEXT];
+    };
+
+    // a bounded lock-free queue (any number of writers, one reader)
+    // drained to a file by a background thread. a writer never waits:
+    // if the queue is full the message is counted and dropped.
+    class Logger{
+        public:
+            LogSlot slots[LOG_SLOTS];
+            std::atomic<size_t> head;
+            size_t tail;
+            std::atomic<long long> dropped;
+            std::atomic<bool> running;
+            std::thread drainer;
+            FILE *out;
+
+            Logger(){
+                for(size_t i=0; i<LOG_SLOTS; i++) slots[i].seq.store(i);
+                head.store(0);
+                tail=0;
+                dropped.store(0);
+                running.store(false);
+                out=NULL;
+            }
+
+            ~Logger(){
+                close();
+            }
+
+            void open(const char *file){
+                close();
+                out=fopen(file, "w");
+                if(!out) return;
+                running.store(true);
+                drainer=std::thread(&Logger::drain, this);
+            }
+
+            void close(){
+                if(!running.load()) return;
+                running.store(false);
+                drainer.join();
+                fclose(out);
+                out=NULL;
+            }
+
+            void push(const char *level, const std::string &msg){
+                if(!running.load(std::memory_order_relaxed)) return;
+                size_t pos=head.load(std::memory_order_relaxed);
+                LogSlot *slot;
+                for(;;){
+                    slot=&slots[pos&(LOG_SLOTS-1)];
+                    size_t seq=slot->seq.load(std::memory_order_acquire);
+                    long long dif=static_cast<long long>(seq)-static_cast<long long>(pos);
+                    if(dif==0){
+                        if(head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+                    }
+                    else if(dif<0){
+                        dropped++;
+                        return;
+                    }
+                    else pos=head.load(std::memory_order_relaxed);
+                }
+                int len=snprintf(slot->text, LOG_TEXT, "[%s] %s\n", level, msg.c_str());
+                if(len>=LOG_TEXT){
+                    len=LOG_TEXT-1;
+                    slot->text[len-1]='\n';
+                }
+                slot->len=len;
+                slot->seq.store(pos+1, std::memory_order_release);
+            }
+
+            bool pop(){
+                LogSlot &slot=slots[tail&(LOG_SLOTS-1)];
+                if(slot.seq.load(std::memory_order_acquire)!=tail+1) return false;
+                fwrite(slot.text, 1, slot.len, out);
+                slot.seq.store(tail+LOG_SLOTS, std::memory_order_release);
+                tail++;
+                return true;
+            }
+
+            void drain(){
+                long long reported=0;
+                while(running.load()){
+                    bool any=false;
+                    while(pop()) any=true;
+                    long long lost=dropped.load();
+                    if(lost!=reported){
+                        fprintf(out, "[log] %lld messages dropped\n", lost-reported);
+                        reported=lost;
+                    }
+                    if(any) fflush(out);
+                    else std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+                while(pop());
+                fflush(out);
+            }
+    };
+
+    Logger LOGGER;
+}
+
+#define LOG_WRITE(level, msg) do{ \
+        std::ostringstream _log_line_; \
+        _log_line_ << msg; \
+        bigdumb::LOGGER.push(level, _log_line_.str()); \
+    }while(0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(msg) LOG_WRITE("error", msg)
+#else
+#define LOG_ERROR(msg) do{}while(0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(msg) LOG_WRITE("info", msg)
+#else
+#define LOG_INFO(msg) do{}while(0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(msg) LOG_WRITE("debug", msg)
+#else
+#define LOG_DEBUG(msg) do{}while(0)
+#endif
+
+#define _log_h
+#endif
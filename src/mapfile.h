@@ -0,0 +1,85 @@
+#ifndef _mapfile_h
+
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bigdumb{
+    // a whole file mapped read-only into memory
+    class MappedFile{
+        public:
+            const unsigned char *data;
+            size_t size;
+#ifdef _WIN32
+            HANDLE file, mapping;
+#endif
+
+            MappedFile(){
+                data=NULL;
+                size=0;
+            }
+
+            ~MappedFile(){
+                close();
+            }
+
+            bool open(const char *path){
+                close();
+#ifdef _WIN32
+                file=CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL, NULL);
+                if(file==INVALID_HANDLE_VALUE) return false;
+                LARGE_INTEGER length;
+                GetFileSizeEx(file, &length);
+                size=static_cast<size_t>(length.QuadPart);
+                mapping=CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                if(!mapping){
+                    CloseHandle(file);
+                    return false;
+                }
+                data=static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if(!data){
+                    CloseHandle(mapping);
+                    CloseHandle(file);
+                    return false;
+                }
+#else
+                int fd=::open(path, O_RDONLY);
+                if(fd<0) return false;
+                struct stat st;
+                if(fstat(fd, &st)<0 || st.st_size==0){
+                    ::close(fd);
+                    return false;
+                }
+                size=static_cast<size_t>(st.st_size);
+                void *p=mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if(p==MAP_FAILED) return false;
+                data=static_cast<const unsigned char *>(p);
+#endif
+                return true;
+            }
+
+            void close(){
+                if(!data) return;
+#ifdef _WIN32
+                UnmapViewOfFile(data);
+                CloseHandle(mapping);
+                CloseHandle(file);
+#else
+                munmap(const_cast<unsigned char *>(data), size);
+#endif
+                data=NULL;
+                size=0;
+            }
+    };
+}
+
+#define _mapfile_h
+#endif
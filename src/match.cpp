@@ -0,0 +1,326 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <list>
+#include <string>
+#include "debug.h"
+#include "movestore.h"
+#include "board.h"
+
+// engine vs engine games between two settings of the search, all in
+// one process:
+//
+//   match [-a name=..,depth=..,contempt=..,futility=..,rfp=..,razor=..]
+//         [-b ...] [-games N]
+//         [-threads N] [-openings file] [-pgn file] [-plies N]
+//         [-sprt elo0,elo1] [-alpha x] [-beta x]
+//
+// every opening is played twice with colours reversed, and the match
+// stops early once the SPRT accepts either hypothesis.
+
+using namespace std;
+
+const char *OPENINGS[] = {
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pppp1ppp/4p3/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pp1ppppp/2p5/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 1 2",
+    "rnbqkbnr/pppppppp/8/8/2P5/8/PP1PPPPP/RNBQKBNR b KQkq - 0 1",
+    "rnbqkbnr/pppppppp/8/8/8/5N2/PPPPPPPP/RNBQKB1R b KQkq - 1 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pppp1ppp/5n2/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkbnr/pp2pppp/3p4/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 0 3",
+};
+
+class EngineConfig{
+    public:
+        string name;
+        int depth;
+        int contempt;
+        int futility;
+        int rfp;
+        int razor;
+        // each side keeps its own table, so scores from one setting
+        // never steer the other. every game thread has its own pair,
+        // emptied before each game, so games don't see each other's
+        bigdumb::TranspositionTable *table;
+};
+
+class GameResult{
+    public:
+        // from the point of view of engine A: 2 win, 1 draw, 0 loss
+        int points;
+        string result;
+        string reason;
+        string pgn;
+};
+
+class Sprt{
+    public:
+        double elo0, elo1, alpha, beta;
+
+        double expected(double elo){
+            return 1/(1+pow(10, -elo/400));
+        }
+
+        // generalised SPRT on the trinomial win/draw/loss model
+        double llr(int w, int d, int l){
+            double n=w+d+l;
+            if(n==0) return 0;
+            double s=(w+d/2.0)/n;
+            double var=(w*(1-s)*(1-s) + d*(0.5-s)*(0.5-s) + l*s*s)/n;
+            if(var<=0) return 0;
+            double s0=expected(elo0), s1=expected(elo1);
+            return n*(s1-s0)*(2*s-s0-s1)/(2*var);
+        }
+
+        double lower(){ return log(beta/(1-alpha)); }
+        double upper(){ return log((1-beta)/alpha); }
+};
+
+EngineConfig parse_config(string name, string spec){
+    EngineConfig e;
+    e.name=name;
+    e.depth=ROOT_DEPTH;
+    e.contempt=CONTEMPT;
+    e.futility=FUTILITY_MARGIN;
+    e.rfp=RFP_MARGIN;
+    e.razor=RAZOR_MARGIN;
+    e.table=&bigdumb::TT;
+    stringstream in(spec);
+    string item;
+    while(getline(in, item, ',')){
+        size_t eq=item.find('=');
+        if(eq==string::npos) continue;
+        string k=item.substr(0, eq), v=item.substr(eq+1);
+        if(k=="name") e.name=v;
+        else if(k=="depth") e.depth=atoi(v.c_str());
+        else if(k=="contempt") e.contempt=atoi(v.c_str());
+        else if(k=="futility") e.futility=atoi(v.c_str());
+        else if(k=="rfp") e.rfp=atoi(v.c_str());
+        else if(k=="razor") e.razor=atoi(v.c_str());
+        else cerr << "warning: unknown engine setting " << k << "\n";
+    }
+    return e;
+}
+
+int repetitions(bigdumb::Board &board){
+    int count=0;
+    for(int i=board.half_move; i>=0 && i>=board.half_move-board.fifty_clock; i-=2){
+        if(i<MAX_GAME_PLY && board.context->keys[i]==board.key) count++;
+    }
+    return count;
+}
+
+bool insufficient_material(bigdumb::Board &board){
+    int minors=0;
+    for(int y=0; y<8; y++){
+        for(int x=0; x<8; x++){
+            switch(board.a[y][x]){
+                case 'p': case 'P': case 'r': case 'R': case 'q': case 'Q': return false;
+                case 'n': case 'N': case 'b': case 'B': minors++; break;
+            }
+        }
+    }
+    return minors<=1;
+}
+
+GameResult play_game(string fen, EngineConfig &white, EngineConfig &black, int max_plies){
+    bigdumb::Board board;
+    board.set_fen(fen);
+    GameResult r;
+    string moves;
+    int start=board.half_move;
+    while(true){
+        bool white_to_move=board.half_move%2==0;
+        list<bigdumb::ChessMove> legal=board.legal_moves();
+        if(legal.empty()){
+            if(board.in_check(white_to_move)){
+                r.result=white_to_move ? "0-1" : "1-0";
+                r.reason="checkmate";
+            }
+            else{
+                r.result="1/2-1/2";
+                r.reason="stalemate";
+            }
+            break;
+        }
+        r.result="1/2-1/2";
+        if(board.fifty_clock>=100){ r.reason="fifty move rule"; break; }
+        if(repetitions(board)>=3){ r.reason="threefold repetition"; break; }
+        if(insufficient_material(board)){ r.reason="insufficient material"; break; }
+        if(board.half_move-start>=max_plies){ r.reason="move limit"; break; }
+
+        EngineConfig &e=white_to_move ? white : black;
+        bigdumb::Board search_board=board;
+        search_board.context->contempt=e.contempt;
+        search_board.context->futility_margin=e.futility;
+        search_board.context->rfp_margin=e.rfp;
+        search_board.context->razor_margin=e.razor;
+        search_board.context->tt=e.table;
+        search_board.search(e.depth);
+        int from=search_board.context->best.from, to=search_board.context->best.to;
+        bool ok=false;
+        for(list<bigdumb::ChessMove>::iterator i=legal.begin(); i!=legal.end(); i++)
+            if((*i).from==from && (*i).to==to) ok=true;
+        if(!ok){
+            r.result=white_to_move ? "0-1" : "1-0";
+            r.reason=e.name+" made an illegal move";
+            break;
+        }
+
+        stringstream number;
+        if(white_to_move) number << board.half_move/2+1 << ". ";
+        else if(moves.empty()) number << board.half_move/2+1 << "... ";
+        string san=board.san(from, to);
+        board.move(board.coord(from, to));
+        if(board.in_check(!white_to_move)) san+=board.legal_moves().empty() ? "#" : "+";
+        moves+=number.str()+san+" ";
+    }
+
+    stringstream pgn;
+    pgn << "[Event \"bigdumb match\"]\n[Site \"local\"]\n"
+        << "[White \"" << white.name << "\"]\n[Black \"" << black.name << "\"]\n"
+        << "[Result \"" << r.result << "\"]\n[Termination \"" << r.reason << "\"]\n"
+        << "[SetUp \"1\"]\n[FEN \"" << fen << "\"]\n\n";
+    // wrap the movetext the way most PGN readers expect
+    stringstream words(moves+r.result);
+    string word;
+    int column=0;
+    while(words >> word){
+        if(column+word.length()>=80){
+            pgn << "\n";
+            column=0;
+        }
+        else if(column){
+            pgn << " ";
+            column++;
+        }
+        pgn << word;
+        column+=word.length();
+    }
+    pgn << "\n\n";
+    r.pgn=pgn.str();
+    return r;
+}
+
+int main(int argc, char **argv){
+    EngineConfig a=parse_config("A", ""), b=parse_config("B", "");
+    int games=1000, threads=thread::hardware_concurrency(), max_plies=300;
+    string openings_file, pgn_file="match.pgn";
+    Sprt sprt;
+    sprt.elo0=0;
+    sprt.elo1=10;
+    sprt.alpha=0.05;
+    sprt.beta=0.05;
+    for(int i=1; i<argc; i+=2){
+        string opt=argv[i];
+        if(i+1>=argc){
+            cerr << "error: " << opt << " needs a value\n";
+            return 1;
+        }
+        string val=argv[i+1];
+        if(opt=="-a") a=parse_config("A", val);
+        else if(opt=="-b") b=parse_config("B", val);
+        else if(opt=="-games") games=atoi(val.c_str());
+        else if(opt=="-threads") threads=atoi(val.c_str());
+        else if(opt=="-openings") openings_file=val;
+        else if(opt=="-pgn") pgn_file=val;
+        else if(opt=="-plies") max_plies=atoi(val.c_str());
+        else if(opt=="-sprt") sscanf(val.c_str(), "%lf,%lf", &sprt.elo0, &sprt.elo1);
+        else if(opt=="-alpha") sprt.alpha=atof(val.c_str());
+        else if(opt=="-beta") sprt.beta=atof(val.c_str());
+        else{
+            cerr << "unknown option " << opt << "\n";
+            return 1;
+        }
+    }
+    if(threads<1) threads=1;
+    precomputeAll();
+
+    vector<string> openings;
+    if(!openings_file.empty()){
+        ifstream in(openings_file.c_str());
+        string line;
+        while(getline(in, line)){
+            bigdumb::Board check;
+            if(check.set_fen(line)) openings.push_back(line);
+        }
+    }
+    else{
+        for(size_t i=0; i<sizeof(OPENINGS)/sizeof(OPENINGS[0]); i++) openings.push_back(OPENINGS[i]);
+    }
+    if(openings.empty()){
+        cerr << "error: no usable openings\n";
+        return 1;
+    }
+
+    ofstream pgn(pgn_file.c_str());
+    mutex lock;
+    atomic<int> next(0);
+    atomic<bool> stop(false);
+    int wins=0, draws=0, losses=0;
+    cout << a.name << " (depth " << a.depth << ", contempt " << a.contempt << ") vs "
+         << b.name << " (depth " << b.depth << ", contempt " << b.contempt << "), "
+         << threads << " threads, SPRT [" << sprt.elo0 << ", " << sprt.elo1 << "]" << endl;
+
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    vector<thread> pool;
+    for(int t=0; t<threads; t++){
+        pool.push_back(thread([&](){
+            bigdumb::TranspositionTable table_a, table_b;
+            EngineConfig ea=a, eb=b;
+            ea.table=&table_a;
+            eb.table=&table_b;
+            while(!stop){
+                int g=next++;
+                if(g>=games) break;
+                string fen=openings[(g/2)%openings.size()];
+                bool a_white=g%2==0;
+                table_a.clear();
+                table_b.clear();
+                GameResult r=a_white ? play_game(fen, ea, eb, max_plies) : play_game(fen, eb, ea, max_plies);
+                bool a_won=(r.result=="1-0" && a_white) || (r.result=="0-1" && !a_white);
+                bool draw=r.result=="1/2-1/2";
+
+                lock_guard<mutex> guard(lock);
+                if(stop) break;
+                if(draw) draws++;
+                else if(a_won) wins++;
+                else losses++;
+                pgn << r.pgn;
+                pgn.flush();
+                double llr=sprt.llr(wins, draws, losses);
+                cout << "game " << g+1 << ": " << (a_white ? a.name+" - "+b.name : b.name+" - "+a.name)
+                     << " " << r.result << " {" << r.reason << "}  +" << wins << " =" << draws
+                     << " -" << losses << "  llr " << llr << " (" << sprt.lower() << ", "
+                     << sprt.upper() << ")" << endl;
+                if(llr>=sprt.upper() || llr<=sprt.lower()) stop=true;
+            }
+        }));
+    }
+    for(size_t t=0; t<pool.size(); t++) pool[t].join();
+    double elapsed=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+    int n=wins+draws+losses;
+    double score=n ? (wins+draws/2.0)/n : 0.5;
+    double llr=sprt.llr(wins, draws, losses);
+    cout << "\n" << n << " games in " << elapsed << "s (" << (elapsed>0 ? 3600*n/elapsed : 0) << " per hour)\n";
+    cout << a.name << " scored " << 100*score << "% (+" << wins << " =" << draws << " -" << losses << ")";
+    if(score>0 && score<1) cout << ", elo " << -400*log10(1/score-1);
+    cout << "\nSPRT llr " << llr << ": ";
+    if(llr>=sprt.upper()) cout << "H1 accepted (elo >= " << sprt.elo1 << ")\n";
+    else if(llr<=sprt.lower()) cout << "H0 accepted (elo <= " << sprt.elo0 << ")\n";
+    else cout << "inconclusive\n";
+    return 0;
+}
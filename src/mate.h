@@ -0,0 +1,230 @@
+#ifndef _mate_h
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "board.h"
+
+// size of the solver's proof table in megabytes, and how many nodes
+// one solve may spend before giving up
+int MATE_MB = 16;
+long long MATE_NODES = 5000000;
+
+#define PN_INF 1000000000u
+
+namespace bigdumb{
+    class MateEntry{
+        public:
+            unsigned long long key;
+            unsigned int pn;
+            unsigned int dn;
+            // nodes spent under this entry; bigger subtrees win the slot
+            unsigned int work;
+    };
+
+    // depth-first proof-number search for "the side to move mates in n".
+    // the attacker's nodes are OR nodes (one move has to mate), the
+    // defender's are AND nodes (every reply has to lose). the remaining
+    // plies are folded into the key, so a position proven with 3 plies
+    // to go is never mistaken for one with 1, and the bound keeps it
+    // free of cycles.
+    class MateSolver{
+        public:
+            std::vector<MateEntry> table;
+            size_t mask;
+            long long nodes;
+            long long max_nodes;
+            // set from another thread to give up early
+            std::atomic<bool> stop;
+
+            MateSolver(){
+                size_t n=1;
+                while(n*2*sizeof(MateEntry)<=static_cast<size_t>(MATE_MB)*1024*1024) n*=2;
+                table.resize(n);
+                mask=n-1;
+                max_nodes=MATE_NODES;
+                stop=false;
+                clear();
+            }
+
+            void clear(){
+                for(size_t i=0; i<table.size(); i++){
+                    table[i].key=0;
+                    table[i].work=0;
+                }
+                nodes=0;
+            }
+
+            unsigned long long node_key(const Board &board, int plies){
+                return board.key ^ (static_cast<unsigned long long>(plies+1)*0x9E3779B97F4A7C15ULL);
+            }
+
+            void lookup(unsigned long long key, unsigned int &pn, unsigned int &dn){
+                MateEntry &e=table[key&mask];
+                if(e.key==key && e.work){
+                    pn=e.pn;
+                    dn=e.dn;
+                }
+                else pn=dn=1;
+            }
+
+            void store(unsigned long long key, unsigned int pn, unsigned int dn, unsigned int work){
+                MateEntry &e=table[key&mask];
+                if(e.key!=key && e.work>work) return;
+                e.key=key;
+                e.pn=pn;
+                e.dn=dn;
+                e.work=work ? work : 1;
+            }
+
+            static void make(Board &board, int from, int to){
+                // Board::move(int,int) is the search's cheap version; a
+                // proof has to get promotions right too
+                char p=board.a[from>>3][from&7];
+                bool pawn=p=='P' || p=='p';
+                board.move(from, to);
+                board.half_move++;
+                if(pawn && (to<8 || to>=56)){
+                    char q=p=='P' ? 'Q' : 'q';
+                    board.key^=ZOBRIST[piece_index(p)][to] ^ ZOBRIST[piece_index(q)][to];
+                    board.material_key+=MATERIAL_UNIT[piece_index(q)]-MATERIAL_UNIT[piece_index(p)];
+                    board.a[to>>3][to&7]=q;
+                }
+            }
+
+            void mid(Board &board, int plies, unsigned int thpn, unsigned int thdn,
+                     unsigned int &pn, unsigned int &dn){
+                // expands `board` until its numbers reach a threshold.
+                // plies is what the attacker has left, so odd means the
+                // attacker is to move.
+                long long start=nodes++;
+                unsigned long long key=node_key(board, plies);
+                bool attacker=plies%2==1;
+                bool white=board.half_move%2==0;
+                bool check=board.in_check(white);
+                // out of moves and not in check can't be mate
+                if(!attacker && plies==0 && !check){
+                    pn=PN_INF;
+                    dn=0;
+                    store(key, pn, dn, 1);
+                    return;
+                }
+                std::vector<Board> children;
+                std::vector<unsigned long long> keys;
+                std::list<ChessMove> moves;
+                board.gen_moves();
+                moves.swap(board.capture);
+                moves.splice(moves.end(), board.quiet);
+                for(std::list<ChessMove>::iterator i=moves.begin(); i!=moves.end(); i++){
+                    Board child=board;
+                    make(child, (*i).from, (*i).to);
+                    if(child.in_check(white)) continue;
+                    // the attacker's last move has to give check
+                    if(attacker && plies==1 && !child.in_check(!white)) continue;
+                    children.push_back(child);
+                    keys.push_back(node_key(child, plies-1));
+                    // at the horizon one legal reply is enough to escape
+                    if(plies==0) break;
+                }
+                if(children.empty() || plies==0){
+                    bool mated=!attacker && children.empty() && check;
+                    pn=mated ? 0 : PN_INF;
+                    dn=mated ? PN_INF : 0;
+                    store(key, pn, dn, 1);
+                    return;
+                }
+                while(true){
+                    // OR: pn is the easiest proof, dn the sum of every
+                    // refutation. AND is the same with the roles swapped.
+                    unsigned long long sum=0;
+                    unsigned int best=PN_INF, second=PN_INF, best_other=0;
+                    int pick=0;
+                    for(size_t c=0; c<children.size(); c++){
+                        unsigned int cpn, cdn;
+                        lookup(keys[c], cpn, cdn);
+                        unsigned int mine=attacker ? cpn : cdn, other=attacker ? cdn : cpn;
+                        sum+=other;
+                        if(mine<best){
+                            second=best;
+                            best=mine;
+                            best_other=other;
+                            pick=c;
+                        }
+                        else if(mine<second) second=mine;
+                    }
+                    unsigned int total=sum>=PN_INF ? PN_INF : static_cast<unsigned int>(sum);
+                    pn=attacker ? best : total;
+                    dn=attacker ? total : best;
+                    if(pn>=thpn || dn>=thdn || stop || nodes>=max_nodes) break;
+                    unsigned int child_pn, child_dn;
+                    unsigned int th_mine=second+1<(attacker ? thpn : thdn) ? second+1 : (attacker ? thpn : thdn);
+                    unsigned int th_other=(attacker ? thdn-dn : thpn-pn)+best_other;
+                    if(attacker) mid(children[pick], plies-1, th_mine, th_other, child_pn, child_dn);
+                    else mid(children[pick], plies-1, th_other, th_mine, child_pn, child_dn);
+                }
+                store(key, pn, dn, static_cast<unsigned int>(nodes-start));
+            }
+
+            bool prove(Board &board, int plies){
+                unsigned int pn=1, dn=1;
+                while(pn && dn && !stop && nodes<max_nodes) mid(board, plies, PN_INF, PN_INF, pn, dn);
+                return pn==0;
+            }
+
+            // shortest mate in at most `n` moves for the side to move:
+            // returns n (and the line) when found, 0 when there is none,
+            // and -1 when it ran out of nodes or was stopped first.
+            int solve(Board root, int n, ChessMove &best, std::string &line){
+                // a context of its own, so it can run beside a search
+                // of the same position
+                root.context=std::make_shared<SearchContext>();
+                root.context->root_ply=root.half_move;
+                nodes=0;
+                for(int k=1; k<=n; k++){
+                    int plies=2*k-1;
+                    if(!prove(root, plies)){
+                        if(stop || nodes>=max_nodes) return -1;
+                        continue;
+                    }
+                    // the line: an attacker move that is proven, then
+                    // any defence, until the mate. the table usually
+                    // still has the proof; if not it is found again.
+                    max_nodes=nodes+MATE_NODES;
+                    Board b=root;
+                    std::ostringstream out;
+                    for(int p=plies; p>0; p--){
+                        std::list<ChessMove> moves=b.legal_moves();
+                        std::list<ChessMove>::iterator pick=moves.end();
+                        // any defence will do; for the attacker take a move
+                        // the table has as proven, and only search again
+                        // when it has been overwritten
+                        for(int pass=(p%2==1 ? 0 : 2); pass<3 && pick==moves.end(); pass++){
+                            for(std::list<ChessMove>::iterator i=moves.begin(); i!=moves.end(); i++){
+                                Board child=b;
+                                make(child, (*i).from, (*i).to);
+                                unsigned int pn, dn;
+                                lookup(node_key(child, p-1), pn, dn);
+                                if(pass==2 || pn==0 || (pass==1 && prove(child, p-1))){
+                                    pick=i;
+                                    break;
+                                }
+                            }
+                        }
+                        if(pick==moves.end()) break;
+                        if(p==plies) best=*pick;
+                        out << (p==plies ? "" : " ") << b.san((*pick).from, (*pick).to);
+                        make(b, (*pick).from, (*pick).to);
+                    }
+                    line=out.str()+"#";
+                    return k;
+                }
+                return 0;
+            }
+    };
+}
+
+#define _mate_h
+#endif
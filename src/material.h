@@ -0,0 +1,139 @@
+#ifndef _material_h
+
+#include <vector>
+
+// material signatures. a board keeps a key of how many of each piece
+// both sides have, four bits a piece (the kings left out), added to and
+// taken from as pieces come and go. positions with up to eight pawns,
+// two knights, bishops and rooks and a queen a side look the key up in
+// a table built once: the game phase, how much of an advantage each
+// side can be trusted to convert, and which endings are known draws or
+// have an evaluator of their own. anything else (extra promoted pieces)
+// is evaluated as usual.
+
+// what a table entry says to do instead of the usual evaluation
+#define EG_NONE 0
+// not enough material to mate, whoever has it
+#define EG_DRAW 1
+// a bare king, or one with a rook against a queen: drive it to the edge
+#define EG_MOPUP 2
+// bishop and knight: to a corner the bishop covers
+#define EG_KBNK 3
+
+// full weight in the scaling factors
+#define SCALE_NORMAL 64
+// phase with every piece on the board; minors count 1, rooks 2, queens 4
+#define PHASE_MAX 24
+
+// a won ending the evaluator recognises is worth this on top of the
+// material, so trading into one is worth it
+int KNOWN_WIN = 1000;
+// and for each step the lone king is pushed out, and the other king in
+int MOPUP_PUSH = 40;
+int MOPUP_CLOSE = 20;
+
+// per piece_index, what the piece adds to the key
+unsigned long long MATERIAL_UNIT[12];
+
+class MaterialEntry{
+    public:
+        unsigned char phase;
+        // out of SCALE_NORMAL, what is kept of a score in that side's favour
+        unsigned char scale[2];
+        unsigned char evaluator;
+        // the side with the winning material, for the evaluators
+        unsigned char strong;
+};
+
+// pawns 0-8, knights, bishops and rooks 0-2, queens 0-1
+#define MATERIAL_SIDE (9*3*3*3*2)
+std::vector<MaterialEntry> MATERIAL_TABLE;
+
+int material_count(unsigned long long key, int piece){
+    return static_cast<int>((key>>(4*piece))&15);
+}
+
+int material_index(unsigned long long key){
+    // the table slot for a key, or -1 past what it covers
+    int index=0;
+    for(int side=0; side<2; side++){
+        int p=material_count(key, 6*side), n=material_count(key, 6*side+1), b=material_count(key, 6*side+2);
+        int r=material_count(key, 6*side+3), q=material_count(key, 6*side+4);
+        if(p>8 || n>2 || b>2 || r>2 || q>1) return -1;
+        index=index*MATERIAL_SIDE+(((p*3+n)*3+b)*3+r)*2+q;
+    }
+    return index;
+}
+
+const MaterialEntry *material_entry(unsigned long long key){
+    int index=material_index(key);
+    return index<0 ? NULL : &MATERIAL_TABLE[index];
+}
+
+void classify_material(MaterialEntry &e, const int count[2][5]){
+    // counts are pawns, knights, bishops, rooks, queens
+    int npm[2], minors[2];
+    for(int s=0; s<2; s++){
+        minors[s]=count[s][1]+count[s][2];
+        // in rough pawns, so the rules don't move when the values are tuned
+        npm[s]=3*minors[s]+5*count[s][3]+9*count[s][4];
+    }
+    int phase=minors[0]+minors[1]+2*(count[0][3]+count[1][3])+4*(count[0][4]+count[1][4]);
+    e.phase=static_cast<unsigned char>(phase<PHASE_MAX ? phase : PHASE_MAX);
+    e.evaluator=EG_NONE;
+    e.strong=0;
+    for(int s=0; s<2; s++){
+        // without pawns, a side needs more than a minor piece to mate,
+        // and more than a minor piece's worth over the other to force it
+        int t=1-s;
+        e.scale[s]=SCALE_NORMAL;
+        if(!count[s][0] && npm[s]-npm[t]<=3) e.scale[s]=npm[s]<5 ? 0 : npm[t]<=3 ? 4 : 14;
+    }
+    if(count[0][0] || count[1][0]) return;
+    for(int s=0; s<2; s++){
+        int t=1-s;
+        bool bare=npm[t]==0;
+        if(bare && count[s][1]==1 && count[s][2]==1 && npm[s]==6){
+            e.evaluator=EG_KBNK;
+            e.strong=s;
+            return;
+        }
+        // two knights can't force it either
+        if(bare && npm[s]==6 && count[s][1]==2){
+            e.evaluator=EG_DRAW;
+            return;
+        }
+        if((bare && npm[s]>=5) || (count[s][4]==1 && npm[s]==9 && count[t][3]==1 && npm[t]==5)){
+            e.evaluator=EG_MOPUP;
+            e.strong=s;
+            return;
+        }
+    }
+    // a minor piece each, or less
+    if(npm[0]<=3 && npm[1]<=3) e.evaluator=EG_DRAW;
+}
+
+void precomputeMaterial(){
+    for(int p=0; p<12; p++){
+        int slot=p%6;
+        MATERIAL_UNIT[p]=slot==5 ? 0 : 1ULL<<(4*p);
+    }
+    MATERIAL_TABLE.resize(MATERIAL_SIDE*MATERIAL_SIDE);
+    int count[2][5];
+    for(int index=0; index<MATERIAL_SIDE*MATERIAL_SIDE; index++){
+        int rest=index;
+        for(int s=1; s>=0; s--){
+            int side=rest%MATERIAL_SIDE;
+            rest/=MATERIAL_SIDE;
+            count[s][4]=side%2; side/=2;
+            count[s][3]=side%3; side/=3;
+            count[s][2]=side%3; side/=3;
+            count[s][1]=side%3; side/=3;
+            count[s][0]=side;
+        }
+        classify_material(MATERIAL_TABLE[index], count);
+    }
+}
+
+#define _material_h
+#endif
@@ -0,0 +1,424 @@
+#ifndef _mcts_h
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.h"
+#include "bench.h"
+
+// monte-carlo tree search, the engine's other way to pick a move
+// (xboard's Search option). every thread plays out from the root of one
+// shared tree: it walks down by the PUCT (or UCT) rule, grows the leaf it
+// reaches by one level and scores it with a quiescence search (or a
+// short alpha-beta, MCTS_LEAF_DEPTH), then adds the result to every node
+// on the way back up. the tree is lock-free: nodes only hold atomics, a
+// leaf is grown by whichever thread claims it first, and a thread
+// passing through a node adds a few lost playouts to it until its own
+// result is in, so the others spread out over the tree.
+//
+// results are the chance of a win for the side that made the move into
+// the node, from the leaf's score on a logistic curve. the move played is
+// the root's most visited.
+
+#define MCTS_OFF 0
+#define MCTS_PUCT 1
+#define MCTS_UCT 2
+
+#define MCTS_LEAF 0
+#define MCTS_GROWING 1
+#define MCTS_GROWN 2
+#define MCTS_TERMINAL 3
+
+// fixed point for results, a won playout adds this much
+#define MCTS_UNIT 65536
+
+// nodes in the arena, allocated once and reused by every search
+int MCTS_NODES = 1<<20;
+// playouts per move when there is no clock
+int MCTS_PLAYOUTS = 20000;
+// exploration weight, in hundredths
+int MCTS_CPUCT = 150;
+// centipawns that make a side ten times as likely to win as lose
+int MCTS_SCALE = 400;
+// and how sharply the move priors follow a child's static score
+int MCTS_PRIOR_SCALE = 100;
+// lost playouts a thread adds to each node on its path
+int MCTS_VIRTUAL_LOSS = 3;
+// alpha-beta depth at the leaves, 0 for quiescence only
+int MCTS_LEAF_DEPTH = 0;
+
+namespace bigdumb{
+    class MctsNode{
+        public:
+            // sum of results, MCTS_UNIT per win and half that per draw
+            std::atomic<long long> value;
+            std::atomic<int> visits;
+            std::atomic<int> virtual_loss;
+            std::atomic<int> state;
+            // the children, valid once state is MCTS_GROWN
+            int first;
+            float prior;
+            unsigned char from, to;
+            unsigned char count;
+            // in half points, when state is MCTS_TERMINAL
+            unsigned char result;
+
+            void reset(int f, int t, float p){
+                value.store(0, std::memory_order_relaxed);
+                visits.store(0, std::memory_order_relaxed);
+                virtual_loss.store(0, std::memory_order_relaxed);
+                state.store(MCTS_LEAF, std::memory_order_relaxed);
+                first=0;
+                count=0;
+                result=0;
+                prior=p;
+                from=static_cast<unsigned char>(f);
+                to=static_cast<unsigned char>(t);
+            }
+    };
+
+    class MctsSearch{
+        public:
+            std::vector<MctsNode> nodes;
+            std::atomic<int> used;
+            // set when the arena runs out; the tree stops growing and
+            // the search ends
+            std::atomic<bool> full;
+            std::atomic<bool> done;
+            std::atomic<long long> playouts;
+            long long max_playouts;
+            bool timed;
+            std::chrono::steady_clock::time_point deadline;
+            int rule;
+            Board root;
+            // the threads' counters, merged once they finish
+            SearchStats stats;
+            std::mutex stats_lock;
+
+            MctsSearch(){
+                used=0;
+                full=false;
+                done=false;
+                playouts=0;
+                max_playouts=0;
+                timed=false;
+                rule=MCTS_PUCT;
+            }
+
+            size_t tree_size(){
+                // used keeps counting past the end once the arena is out
+                return full ? nodes.size() : static_cast<size_t>(used.load());
+            }
+
+            int allocate(int n){
+                int at=used.fetch_add(n);
+                if(at+n>static_cast<int>(nodes.size())){
+                    full=true;
+                    return -1;
+                }
+                return at;
+            }
+
+            static double win_chance(int score){
+                // white minus black centipawns, for white
+                if(score>=MATE_BOUND) return 1;
+                if(score<=-MATE_BOUND) return 0;
+                return 1/(1+pow(10.0, -score/static_cast<double>(MCTS_SCALE)));
+            }
+
+            static int centipawns(double q){
+                if(q<0.001) q=0.001;
+                if(q>0.999) q=0.999;
+                return static_cast<int>(MCTS_SCALE*log10(q/(1-q)));
+            }
+
+            int select(const MctsNode &parent){
+                // the child with the best bound; virtual losses count as
+                // visits that won nothing
+                int n_parent=parent.visits.load(std::memory_order_relaxed)
+                    +parent.virtual_loss.load(std::memory_order_relaxed);
+                double c=MCTS_CPUCT/100.0;
+                double explore=rule==MCTS_UCT ? log(static_cast<double>(n_parent>1 ? n_parent : 1))
+                    : sqrt(static_cast<double>(n_parent>1 ? n_parent : 1));
+                // an unvisited child starts from what the parent is worth
+                // to the side choosing, under PUCT
+                int v=parent.visits.load(std::memory_order_relaxed);
+                double fpu=v ? 1-parent.value.load(std::memory_order_relaxed)/static_cast<double>(MCTS_UNIT)/v : 0.5;
+                int best=parent.first;
+                double best_score=-1;
+                for(int i=parent.first; i<parent.first+parent.count; i++){
+                    const MctsNode &child=nodes[i];
+                    int n=child.visits.load(std::memory_order_relaxed)
+                        +child.virtual_loss.load(std::memory_order_relaxed);
+                    double score;
+                    if(rule==MCTS_UCT){
+                        // children are sorted by prior, so the likeliest
+                        // unvisited one goes first
+                        if(!n) return i;
+                        score=child.value.load(std::memory_order_relaxed)/static_cast<double>(MCTS_UNIT)/n
+                            +c*sqrt(explore/n);
+                    }
+                    else{
+                        double q=n ? child.value.load(std::memory_order_relaxed)/static_cast<double>(MCTS_UNIT)/n : fpu;
+                        score=q+c*child.prior*explore/(1+n);
+                    }
+                    if(score>best_score){
+                        best_score=score;
+                        best=i;
+                    }
+                }
+                return best;
+            }
+
+            void prepare(Board &board){
+                // the board's context treats it as a search root, so
+                // quiesce counts plies and the network keeps up from here
+                board.context->root_ply=board.half_move;
+                if(USE_NNUE){
+                    if(board.context->accumulators.empty()) board.context->accumulators.resize(MAX_PLY+1);
+                    nnue_refresh(board.context->accumulators[0], board.a);
+                }
+            }
+
+            bool grow(Board &board, MctsNode &node){
+                // gives the node its legal moves as children, priors from
+                // a softmax over their static scores. false when another
+                // thread has it or the arena is out
+                int expected=MCTS_LEAF;
+                if(!node.state.compare_exchange_strong(expected, MCTS_GROWING)) return false;
+                bool white=board.half_move%2==0;
+                Board temp_board=board;
+                temp_board.gen_moves();
+                std::vector<std::pair<double, ChessMove> > moves;
+                std::list<ChessMove>::iterator i;
+                for(int list=0; list<2; list++){
+                    std::list<ChessMove> &l=list ? temp_board.quiet : temp_board.capture;
+                    for(i=l.begin(); i!=l.end(); i++){
+                        Board child=board;
+                        child.move((*i).from, (*i).to);
+                        if(child.in_check(white)) continue;
+                        child.half_move++;
+                        int score=child.evaluate();
+                        moves.push_back(std::make_pair(static_cast<double>(white ? score : -score), *i));
+                    }
+                }
+                if(moves.empty()){
+                    // mated, or stalemate
+                    node.result=board.in_check(white) ? 2 : 1;
+                    node.state.store(MCTS_TERMINAL, std::memory_order_release);
+                    return true;
+                }
+                int first=allocate(moves.size());
+                if(first<0){
+                    node.state.store(MCTS_LEAF, std::memory_order_release);
+                    return false;
+                }
+                std::sort(moves.begin(), moves.end(),
+                    [](const std::pair<double, ChessMove> &x, const std::pair<double, ChessMove> &y){ return x.first>y.first; });
+                double top=moves[0].first, sum=0;
+                std::vector<double> weight(moves.size());
+                for(size_t m=0; m<moves.size(); m++){
+                    weight[m]=exp((moves[m].first-top)/MCTS_PRIOR_SCALE);
+                    sum+=weight[m];
+                }
+                for(size_t m=0; m<moves.size(); m++)
+                    nodes[first+m].reset(moves[m].second.from, moves[m].second.to, static_cast<float>(weight[m]/sum));
+                node.first=first;
+                node.count=static_cast<unsigned char>(moves.size());
+                node.state.store(MCTS_GROWN, std::memory_order_release);
+                return true;
+            }
+
+            double leaf(Board &board){
+                // the leaf's score, as a result for the side that moved
+                // into it
+                int score;
+                if(MCTS_LEAF_DEPTH>0) score=board.search(MCTS_LEAF_DEPTH);
+                else{
+                    // quiesce leaves counting its first node to the caller
+                    board.count_node();
+                    if(board.half_move%2==0) score=board.quiesce<SIDE_WHITE>(INT_MIN, INT_MAX, CAPTURE_DEPTH);
+                    else score=board.quiesce<SIDE_BLACK>(INT_MIN, INT_MAX, CAPTURE_DEPTH);
+                }
+                double white=win_chance(score);
+                return board.half_move%2==0 ? 1-white : white;
+            }
+
+            void playout(Board board, std::vector<int> &path){
+                path.clear();
+                path.push_back(0);
+                int at=0;
+                while(nodes[at].state.load(std::memory_order_acquire)==MCTS_GROWN){
+                    at=select(nodes[at]);
+                    nodes[at].virtual_loss.fetch_add(MCTS_VIRTUAL_LOSS, std::memory_order_relaxed);
+                    board.move(nodes[at].from, nodes[at].to);
+                    board.half_move++;
+                    board.push_key();
+                    path.push_back(at);
+                }
+                MctsNode &node=nodes[at];
+                double result;
+                if(node.state.load(std::memory_order_acquire)==MCTS_TERMINAL) result=node.result/2.0;
+                else if(at && board.is_draw()){
+                    // the same path always leads here, so it stays a draw
+                    node.result=1;
+                    int expected=MCTS_LEAF;
+                    node.state.compare_exchange_strong(expected, MCTS_TERMINAL);
+                    result=0.5;
+                }
+                else{
+                    prepare(board);
+                    // a leaf some other thread is growing is scored anyway
+                    grow(board, node);
+                    if(node.state.load(std::memory_order_acquire)==MCTS_TERMINAL) result=node.result/2.0;
+                    else result=leaf(board);
+                }
+                for(int i=path.size()-1; i>=0; i--){
+                    MctsNode &n=nodes[path[i]];
+                    n.value.fetch_add(static_cast<long long>(result*MCTS_UNIT), std::memory_order_relaxed);
+                    n.visits.fetch_add(1, std::memory_order_relaxed);
+                    if(i) n.virtual_loss.fetch_sub(MCTS_VIRTUAL_LOSS, std::memory_order_relaxed);
+                    result=1-result;
+                }
+            }
+
+            void worker(){
+                // a board and context of its own, with the game's keys so
+                // repetitions before the root count
+                Board board=root;
+                board.context=std::make_shared<SearchContext>();
+                memcpy(board.context->keys, root.context->keys, sizeof(board.context->keys));
+                board.context->contempt=root.context->contempt;
+                board.context->tt=root.context->tt;
+                std::vector<int> path;
+                while(!done){
+                    playout(board, path);
+                    long long n=++playouts;
+                    if(full || root.context->stop || (max_playouts && n>=max_playouts)
+                            || (timed && (n&63)==0 && std::chrono::steady_clock::now()>=deadline)) done=true;
+                }
+                std::lock_guard<std::mutex> guard(stats_lock);
+                stats.merge(board.context->stats);
+            }
+
+            int run(const Board &board, int search_rule, int threads, int movetime){
+                // searches until movetime (ms) is up, or for MCTS_PLAYOUTS
+                // without one; returns the root's score, white minus
+                // black, and leaves the move in board.context->best
+                if(static_cast<int>(nodes.size())!=MCTS_NODES) std::vector<MctsNode>(MCTS_NODES).swap(nodes);
+                root=board;
+                rule=search_rule;
+                used=1;
+                full=false;
+                done=false;
+                playouts=0;
+                stats.clear();
+                nodes[0].reset(0, 0, 1);
+                timed=movetime>0;
+                max_playouts=timed ? 0 : MCTS_PLAYOUTS;
+                deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(movetime);
+                if(threads<1) threads=1;
+                std::vector<std::thread> pool;
+                for(int t=0; t<threads; t++) pool.push_back(std::thread(&MctsSearch::worker, this));
+                for(size_t t=0; t<pool.size(); t++) pool[t].join();
+                const MctsNode &top=nodes[0];
+                ChessMove best;
+                best.from=-1;
+                int most=-1;
+                double q=0.5;
+                if(top.state.load()==MCTS_GROWN){
+                    for(int i=top.first; i<top.first+top.count; i++){
+                        int v=nodes[i].visits.load();
+                        if(v<=most) continue;
+                        most=v;
+                        best.from=nodes[i].from;
+                        best.to=nodes[i].to;
+                        q=v ? nodes[i].value.load()/static_cast<double>(MCTS_UNIT)/v : 0.5;
+                    }
+                }
+                board.context->best=best;
+                int score=centipawns(q);
+                return board.half_move%2==0 ? score : -score;
+            }
+
+            std::string think(Board &board, int search_rule, int threads, int movetime){
+                // think() for the tree search: plays the move on the board
+                // and returns it, or "" with none to play. the learning
+                // file and the tracer are alpha-beta's and sit this one out
+                int ply=board.half_move;
+                std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+                board.context->stats.clear();
+                int score=run(board, search_rule, threads, movetime);
+                board.context->stats=stats;
+                double elapsed=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+                // only the log reads it, and LOG_LEVEL=0 compiles that out
+                (void)elapsed;
+                if(board.context->best.from<0) return "";
+                std::string played=board.coord(board.context->best.from, board.context->best.to);
+                board.move(played);
+                LOG_INFO("mcts played " << played << " score " << score << " playouts " << playouts
+                         << " (" << static_cast<long long>(elapsed>0 ? playouts/elapsed : 0) << "/s, "
+                         << threads << " threads) tree " << tree_size() << " nodes");
+                LOG_DEBUG(board.board_string());
+                if(!TELEMETRY_FILE.empty()){
+                    std::ostringstream line;
+                    line << "{\"ply\":" << ply << ",\"move\":\"" << played << "\",\"playouts\":" << playouts
+                         << ",\"tree\":" << tree_size()
+                         << ",\"score\":" << score << "," << stats.json() << "}";
+                    append_telemetry(line.str());
+                }
+                return played;
+            }
+    };
+
+    void run_mcts_bench(int playouts, int max_threads, int search_rule){
+        // playouts per second over the bench positions with 1, 2, 4 ...
+        // threads up to max_threads, each position from an empty tree
+        int count=sizeof(BENCH_POSITIONS)/sizeof(BENCH_POSITIONS[0]);
+        MctsSearch mcts;
+        int saved=MCTS_PLAYOUTS;
+        MCTS_PLAYOUTS=playouts;
+        double base=0;
+        std::cout << "threads   playouts/s   speedup\n";
+        for(int threads=1; threads<=max_threads; ){
+            long long total=0;
+            std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+            for(int i=0; i<count; i++){
+                Board board;
+                if(!board.set_fen(BENCH_POSITIONS[i])){
+                    std::cerr << "error: bad bench position " << BENCH_POSITIONS[i] << "\n";
+                    kill_engine();
+                }
+                TT.clear();
+                mcts.run(board, search_rule, threads, 0);
+                total+=mcts.playouts;
+            }
+            double elapsed=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            double rate=elapsed>0 ? total/elapsed : 0;
+            if(threads==1) base=rate;
+            char line[64];
+            snprintf(line, sizeof(line), "%7d %12.0f %8.2fx", threads, rate, base>0 ? rate/base : 0);
+            std::cout << line << std::endl;
+            // the last step is max_threads itself, power of two or not
+            int next=threads*2;
+            if(threads<max_threads && next>max_threads) next=max_threads;
+            threads=next;
+        }
+        MCTS_PLAYOUTS=saved;
+    }
+}
+
+#define _mcts_h
+#endif
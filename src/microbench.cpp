@@ -0,0 +1,321 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <list>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+#include "debug.h"
+#include "movestore.h"
+#include "board.h"
+#include "bench.h"
+#include "batch.h"
+
+// times the engine's inner kernels one at a time over the bench
+// positions:
+//
+//   microbench [-samples N] [-warmup N] [-min-ms N] [-cpu N]
+//              [-only name] [-out file]
+//
+// each sample runs a kernel over the whole corpus enough times to last
+// at least -min-ms, and reports the time per call. after the warmup
+// samples are thrown away, the table on stderr has the median and
+// spread of the rest, and every kernel is written as one JSON line to
+// -out (stdout by default), so two builds can be compared kernel by
+// kernel.
+//
+// the batch kernels (batch.h) are first checked against the scalar
+// code on every position; a mismatch is an error, not a timing.
+
+using namespace std;
+
+class Kernel{
+    public:
+        string name;
+        // runs the kernel once on every position, returns something
+        // that depends on the work so it isn't optimised away
+        function<long long()> run;
+};
+
+class Result{
+    public:
+        string name;
+        long long calls;
+        vector<double> ns;
+
+        double percentile(double p) const {
+            // nearest rank on the sorted samples
+            vector<double> s=ns;
+            sort(s.begin(), s.end());
+            size_t i=static_cast<size_t>(p/100*(s.size()-1)+0.5);
+            return s[i];
+        }
+
+        double mean() const {
+            double sum=0;
+            for(size_t i=0; i<ns.size(); i++) sum+=ns[i];
+            return sum/ns.size();
+        }
+
+        double stddev() const {
+            double m=mean(), sum=0;
+            for(size_t i=0; i<ns.size(); i++) sum+=(ns[i]-m)*(ns[i]-m);
+            return ns.size()>1 ? sqrt(sum/(ns.size()-1)) : 0;
+        }
+
+        string json() const {
+            ostringstream out;
+            out << "{\"kernel\":\"" << name << "\",\"calls\":" << calls
+                << ",\"samples\":" << ns.size()
+                << ",\"min_ns\":" << percentile(0) << ",\"p10_ns\":" << percentile(10)
+                << ",\"median_ns\":" << percentile(50) << ",\"p90_ns\":" << percentile(90)
+                << ",\"max_ns\":" << percentile(100)
+                << ",\"mean_ns\":" << mean() << ",\"stddev_ns\":" << stddev() << "}";
+            return out.str();
+        }
+};
+
+bool pin_to_cpu(int cpu){
+    // keeps the scheduler from moving the run between cores mid sample
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1)<<cpu)!=0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set)==0;
+#else
+    return false;
+#endif
+}
+
+Result measure(const Kernel &k, int positions, int samples, int warmup, double min_ms){
+    Result r;
+    r.name=k.name;
+    volatile long long sink=0;
+    // how many passes over the corpus make one sample long enough
+    long long reps=1;
+    while(true){
+        chrono::steady_clock::time_point start=chrono::steady_clock::now();
+        for(long long i=0; i<reps; i++) sink+=k.run();
+        double ms=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+        if(ms>=min_ms) break;
+        reps*=2;
+    }
+    r.calls=reps*positions;
+    for(int s=0; s<warmup+samples; s++){
+        chrono::steady_clock::time_point start=chrono::steady_clock::now();
+        for(long long i=0; i<reps; i++) sink+=k.run();
+        double ns=chrono::duration<double, nano>(chrono::steady_clock::now()-start).count();
+        if(s>=warmup) r.ns.push_back(ns/r.calls);
+    }
+    return r;
+}
+
+int main(int argc, char **argv){
+    int samples=25, warmup=5, cpu=-1;
+    double min_ms=20;
+    string only, out_file;
+    for(int i=1; i+1<argc; i+=2){
+        string opt=argv[i], val=argv[i+1];
+        if(opt=="-samples") samples=atoi(val.c_str());
+        else if(opt=="-warmup") warmup=atoi(val.c_str());
+        else if(opt=="-min-ms") min_ms=atof(val.c_str());
+        else if(opt=="-cpu") cpu=atoi(val.c_str());
+        else if(opt=="-only") only=val;
+        else if(opt=="-out") out_file=val;
+        else{
+            cerr << "unknown option " << opt << "\n";
+            return 1;
+        }
+    }
+    if(samples<1) samples=1;
+    if(warmup<0) warmup=0;
+    if(cpu>=0 && !pin_to_cpu(cpu)) cerr << "warning: can't pin to cpu " << cpu << "\n";
+    precomputeAll();
+
+    // the corpus, each board with its moves generated the way the search
+    // leaves it before copying, plus what the move kernels need
+    int count=sizeof(BENCH_POSITIONS)/sizeof(BENCH_POSITIONS[0]);
+    vector<bigdumb::Board> boards(count);
+    vector<bigdumb::PositionBatch> batches((count+BATCH_LANES-1)/BATCH_LANES);
+    vector<bigdumb::ChessMove> first(count);
+    vector<vector<pair<int, bitset<64> > > > targets(count);
+    for(int i=0; i<count; i++){
+        bigdumb::Board &b=boards[i];
+        if(!b.set_fen(BENCH_POSITIONS[i])){
+            cerr << "error: bad bench position " << BENCH_POSITIONS[i] << "\n";
+            return 1;
+        }
+        batches[i/BATCH_LANES].add(b);
+        bigdumb::Board scalar=b;
+        scalar.gen_moves();
+        int stm=b.half_move%2==0 ? SIDE_WHITE : SIDE_BLACK;
+        bigdumb::PositionBatch &batch=batches[i/BATCH_LANES];
+        batch.compute();
+        int lane=i%BATCH_LANES;
+        if(batch.attacks[0][lane]!=scalar.attacks().all[0].to_ullong()
+                || batch.attacks[1][lane]!=scalar.attacks().all[1].to_ullong()
+                || batch.moves[stm][lane]!=scalar.capture.size()+scalar.quiet.size()
+                || batch.material[lane]!=b.material<SIDE_WHITE>()-b.material<SIDE_BLACK>()){
+            cerr << "error: the batch kernels disagree with the board on " << BENCH_POSITIONS[i] << "\n";
+            return 1;
+        }
+        b.gen_moves();
+        first[i]=b.capture.empty() ? b.quiet.front() : b.capture.front();
+        const bitset<64> &own=b.half_move%2==0 ? b.white : b.black;
+        for(int sq=0; sq<64; sq++){
+            char p=b.a[sq>>3][sq&7];
+            if(!own.test(sq) || p=='P' || p=='p') continue;
+            targets[i].push_back(make_pair(sq, b.attacks().piece[sq] & ~own));
+        }
+    }
+
+    vector<Kernel> kernels;
+    Kernel k;
+    k.name="board_copy";
+    k.run=[&](){
+        // the copy every child of a search node starts with
+        long long x=0;
+        for(int i=0; i<count; i++){
+            bigdumb::Board c=boards[i];
+            x+=c.half_move;
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="copy_and_move";
+    k.run=[&](){
+        long long x=0;
+        for(int i=0; i<count; i++){
+            bigdumb::Board c=boards[i];
+            c.move(first[i].from, first[i].to);
+            c.half_move++;
+            x+=c.key&1;
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="recompute_bitboards";
+    k.run=[&](){
+        long long x=0;
+        for(int i=0; i<count; i++){
+            boards[i].recompute_bitboards();
+            x+=boards[i].occupied.count();
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="attacks";
+    k.run=[&](){
+        long long x=0;
+        for(int i=0; i<count; i++){
+            boards[i].attacks_ready=false;
+            x+=boards[i].attacks().all[0].count();
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="add_move_from_bitmap";
+    k.run=[&](){
+        long long x=0;
+        for(int i=0; i<count; i++){
+            bigdumb::Board &b=boards[i];
+            b.quiet.clear();
+            b.capture.clear();
+            for(size_t t=0; t<targets[i].size(); t++) b.add_move_from_bitmap(targets[i][t].first, targets[i][t].second);
+            x+=b.quiet.size()+b.capture.size();
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="gen_moves";
+    k.run=[&](){
+        // as a new node sees it, attack tables included
+        long long x=0;
+        for(int i=0; i<count; i++){
+            boards[i].attacks_ready=false;
+            boards[i].gen_moves();
+            x+=boards[i].quiet.size()+boards[i].capture.size();
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="generate_captures";
+    k.run=[&](){
+        // the first stage of a node that gets past the table's move
+        long long x=0;
+        for(int i=0; i<count; i++){
+            boards[i].attacks_ready=false;
+            if(boards[i].half_move%2==0) boards[i].generate_captures<SIDE_WHITE>();
+            else boards[i].generate_captures<SIDE_BLACK>();
+            x+=boards[i].capture.size();
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="batch_compute";
+    k.run=[&](){
+        // attacks, move counts and material, BATCH_LANES positions at a
+        // time; the time is still per position
+        long long x=0;
+        for(size_t i=0; i<batches.size(); i++){
+            batches[i].compute();
+            x+=batches[i].moves[0][0]+batches[i].material[0];
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="material";
+    k.run=[&](){
+        long long x=0;
+        for(int i=0; i<count; i++) x+=boards[i].material<SIDE_WHITE>()-boards[i].material<SIDE_BLACK>();
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="evaluate";
+    k.run=[&](){
+        long long x=0;
+        for(int i=0; i<count; i++){
+            boards[i].attacks_ready=false;
+            x+=boards[i].evaluate();
+        }
+        return x;
+    };
+    kernels.push_back(k);
+    k.name="in_check";
+    k.run=[&](){
+        long long x=0;
+        for(int i=0; i<count; i++){
+            boards[i].attacks_ready=false;
+            x+=boards[i].in_check(boards[i].half_move%2==0);
+        }
+        return x;
+    };
+    kernels.push_back(k);
+
+    ofstream file;
+    if(!out_file.empty()) file.open(out_file.c_str());
+    ostream &out=out_file.empty() ? cout : file;
+    fprintf(stderr, "%-22s %10s %10s %10s %10s %8s\n", "kernel", "min ns", "p10 ns", "median ns", "p90 ns", "spread");
+    for(size_t i=0; i<kernels.size(); i++){
+        if(!only.empty() && kernels[i].name!=only) continue;
+        Result r=measure(kernels[i], count, samples, warmup, min_ms);
+        double median=r.percentile(50);
+        fprintf(stderr, "%-22s %10.1f %10.1f %10.1f %10.1f %7.1f%%\n", r.name.c_str(),
+                r.percentile(0), r.percentile(10), median, r.percentile(90),
+                median>0 ? 100*(r.percentile(90)-r.percentile(10))/median : 0);
+        out << r.json() << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "debug.h"
+#include "movestore.h"
+#include "board.h"
+
+// checks the search's move making against what it has got wrong
+// before:
+//
+//   movecheck
+//
+// prints each failed check and exits 1 if any failed, 0 otherwise.
+
+using namespace std;
+
+int failures=0;
+
+void check(bool ok, const string &what){
+    if(ok) return;
+    cerr << "FAIL: " << what << "\n";
+    failures++;
+}
+
+bool generates(bigdumb::Board &b, const string &crd){
+    b.gen_moves();
+    for(list<bigdumb::ChessMove>::iterator i=b.capture.begin(); i!=b.capture.end(); i++)
+        if(b.coord((*i).from, (*i).to)==crd) return true;
+    for(list<bigdumb::ChessMove>::iterator i=b.quiet.begin(); i!=b.quiet.end(); i++)
+        if(b.coord((*i).from, (*i).to)==crd) return true;
+    return false;
+}
+
+void play(bigdumb::Board &b, const string &crd){
+    // the way the search makes a move, not the xboard way
+    b.move(8*('8'-crd[1])+crd[0]-'a', 8*('8'-crd[3])+crd[2]-'a');
+    b.half_move++;
+}
+
+bool keys_agree(bigdumb::Board &b){
+    return b.key==b.compute_key() && b.material_key==b.compute_material_key();
+}
+
+int main(){
+    precomputeAll();
+
+    // the en passant square e2e4 leaves mustn't outlive black's reply
+    bigdumb::Board b;
+    b.move(string("e2e4"));
+    bigdumb::Board child=b;
+    play(child, "a7a6");
+    check(child.enpassant_square==64, "e2e4 a7a6 leaves an en passant square");
+    check(!generates(child, "d2e3"), "e2e4 a7a6 generates d2e3");
+    check(keys_agree(child), "e2e4 a7a6 keys");
+
+    // a double push sets it, and the capture takes the pawn
+    b.set_fen("4k3/8/8/8/1p6/8/P7/4K3 w - - 0 1");
+    play(b, "a2a4");
+    check(b.enpassant_square==40, "a2a4 sets a3");
+    check(keys_agree(b), "a2a4 keys");
+    check(generates(b, "b4a3"), "a2a4 doesn't allow b4a3");
+    play(b, "b4a3");
+    check(b.a[4][0]=='.', "b4a3 leaves the a4 pawn");
+    check(b.a[5][0]=='p', "b4a3 doesn't land on a3");
+    check(keys_agree(b), "b4a3 keys");
+
+    // and either pawn beside the double push can take it
+    b.set_fen("4k3/8/8/8/1p1p4/8/2P5/4K3 w - - 0 1");
+    play(b, "c2c4");
+    check(generates(b, "b4c3") && generates(b, "d4c3"), "c2c4 allows only one en passant capture");
+    check(b.enpassant_square==42, "generating moves uses up the en passant square");
+
+    // positions apart only in en passant rights are apart in the table
+    bigdumb::Board with, without;
+    with.set_fen("4k3/8/8/8/Pp6/8/8/4K3 b - a3 0 1");
+    without.set_fen("4k3/8/8/8/Pp6/8/8/4K3 b - - 0 1");
+    check(with.key!=without.key, "en passant rights don't change the key");
+
+    if(failures) cerr << failures << " checks failed\n";
+    else cerr << "all checks passed\n";
+    return failures ? 1 : 0;
+}
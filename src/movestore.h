@@ -1,6 +1,8 @@
 #ifndef _movestore_h
 #include <bitset>
+#include <mutex>
 #include "moves.h"
+#include "material.h"
 
 std::bitset<64> BLACKPAWNFORK[64];
 std::bitset<64> WHITEPAWNFORK[64];
@@ -12,6 +14,21 @@ std::bitset<64> RIGHT[64], LEFT[64], UP[64], DOWN[64];
 std::bitset<64> LEFTUP[64], RIGHTUP[64], LEFTDOWN[64], RIGHTDOWN[64];
 std::bitset<64> N[64];
 std::bitset<64> K[64];
+unsigned long long ZOBRIST[12][64];
+unsigned long long ZOBRIST_SIDE;
+unsigned long long ZOBRIST_CASTLE[2];
+// by the file of the en passant square, when there is one
+unsigned long long ZOBRIST_EP[8];
+
+int piece_index(char p){
+    switch(p){
+        case 'P': return 0; case 'N': return 1; case 'B': return 2;
+        case 'R': return 3; case 'Q': return 4; case 'K': return 5;
+        case 'p': return 6; case 'n': return 7; case 'b': return 8;
+        case 'r': return 9; case 'q': return 10; case 'k': return 11;
+    }
+    return -1;
+}
 
 void precomputePawns(){
     for(int i=0; i<64; i++){
@@ -87,6 +104,63 @@ void precomputeKing(){
     }
 }
 
+void precomputeZobrist(){
+    // xorshift with a fixed seed, so keys (and node counts) are the
+    // same on every run.
+    unsigned long long s=0x9E3779B97F4A7C15ULL;
+    for(int p=0; p<12; p++){
+        for(int i=0; i<64; i++){
+            s^=s<<13; s^=s>>7; s^=s<<17;
+            ZOBRIST[p][i]=s;
+        }
+    }
+    s^=s<<13; s^=s>>7; s^=s<<17;
+    ZOBRIST_SIDE=s;
+    for(int i=0; i<2; i++){
+        s^=s<<13; s^=s>>7; s^=s<<17;
+        ZOBRIST_CASTLE[i]=s;
+    }
+    for(int i=0; i<8; i++){
+        s^=s<<13; s^=s>>7; s^=s<<17;
+        ZOBRIST_EP[i]=s;
+    }
+}
+
+template<int STEP>
+inline std::bitset<64> slide(const std::bitset<64> &ray, const std::bitset<64> &occupied){
+    // the squares of `ray` up to and including the first piece on it.
+    // everything behind a blocker is shifted out along the ray; STEP is
+    // the square difference between neighbours, negative towards a8.
+    std::bitset<64> blockers=ray & occupied, shadow;
+    for(int i=1; i<7; i++) shadow|=STEP>0 ? blockers<<(i*STEP) : blockers>>(-i*STEP);
+    return ray ^ (shadow & ray);
+}
+
+inline std::bitset<64> rook_attacks(int sq, const std::bitset<64> &occupied){
+    return slide<-8>(UP[sq], occupied) | slide<8>(DOWN[sq], occupied)
+        | slide<-1>(LEFT[sq], occupied) | slide<1>(RIGHT[sq], occupied);
+}
+
+inline std::bitset<64> bishop_attacks(int sq, const std::bitset<64> &occupied){
+    return slide<-9>(LEFTUP[sq], occupied) | slide<-7>(RIGHTUP[sq], occupied)
+        | slide<7>(LEFTDOWN[sq], occupied) | slide<9>(RIGHTDOWN[sq], occupied);
+}
+
+std::once_flag PRECOMPUTED;
+
+void precomputeAll(){
+    // the tables never change once built, so every session and thread
+    // shares them, and only the first call does the work
+    std::call_once(PRECOMPUTED, [](){
+        precomputeKing();
+        precomputeKnights();
+        precomputePawns();
+        precomputeSliding();
+        precomputeZobrist();
+        precomputeMaterial();
+    });
+}
+
 void print(std::bitset<64> bitboard){
     for(int i=0; i<64; i++){
         if(i%8==0) std::cerr << "\n" << 8-(i/8);
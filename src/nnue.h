@@ -0,0 +1,245 @@
+#ifndef _nnue_h
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "mapfile.h"
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+// an efficiently updatable network, HalfKP style. each side sees the
+// board from its own end: an input is (own king square, piece, square)
+// for the 10 kinds of non-king piece, own ones first. squares are the
+// board's own 0=a8 numbering, flipped top to bottom for black.
+//
+//   40960 inputs -> 256 per side (int16, kept incrementally)
+//   512 (side to move first, clipped to 0..127) -> 32 -> 32 -> 1 (int8)
+//
+// file layout, little endian, no padding:
+//   "BDNN", uint32 version=1
+//   int16 ft_bias[256], int16 ft_weights[40960][256]
+//   int32 l1_bias[32], int8 l1_weights[32][512]
+//   int32 l2_bias[32], int8 l2_weights[32][32]
+//   int32 out_bias, int8 out_weights[32]
+
+#define NNUE_INPUTS 40960
+#define NNUE_HALF 256
+#define NNUE_HIDDEN 32
+#define NNUE_SHIFT 6
+#define NNUE_SCALE 16
+
+bool USE_NNUE = false;
+
+namespace bigdumb{
+    class Accumulator{
+        public:
+            alignas(32) int16_t v[2][NNUE_HALF];
+            int king[2];
+            // a king got captured (the search is pseudo-legal); the network
+            // has no input for that, so the board falls back to material
+            bool king_lost;
+    };
+
+    class Network{
+        public:
+            MappedFile file;
+            const int16_t *ft_bias;
+            const int16_t *ft_weights;
+            const int32_t *l1_bias;
+            const int8_t *l1_weights;
+            const int32_t *l2_bias;
+            const int8_t *l2_weights;
+            const int32_t *out_bias;
+            const int8_t *out_weights;
+
+            bool load(const char *path){
+                if(!file.open(path)) return false;
+                size_t expected=8 + 2*NNUE_HALF + 2*NNUE_INPUTS*NNUE_HALF
+                    + 4*NNUE_HIDDEN + NNUE_HIDDEN*2*NNUE_HALF
+                    + 4*NNUE_HIDDEN + NNUE_HIDDEN*NNUE_HIDDEN + 4 + NNUE_HIDDEN;
+                // the size first: a shorter file hasn't got the header
+                uint32_t version=0;
+                if(file.size==expected) memcpy(&version, file.data+4, 4);
+                if(file.size!=expected || memcmp(file.data, "BDNN", 4)!=0 || version!=1){
+                    file.close();
+                    return false;
+                }
+                const unsigned char *p=file.data+8;
+                ft_bias=reinterpret_cast<const int16_t *>(p); p+=2*NNUE_HALF;
+                ft_weights=reinterpret_cast<const int16_t *>(p); p+=2*NNUE_INPUTS*NNUE_HALF;
+                l1_bias=reinterpret_cast<const int32_t *>(p); p+=4*NNUE_HIDDEN;
+                l1_weights=reinterpret_cast<const int8_t *>(p); p+=NNUE_HIDDEN*2*NNUE_HALF;
+                l2_bias=reinterpret_cast<const int32_t *>(p); p+=4*NNUE_HIDDEN;
+                l2_weights=reinterpret_cast<const int8_t *>(p); p+=NNUE_HIDDEN*NNUE_HIDDEN;
+                out_bias=reinterpret_cast<const int32_t *>(p); p+=4;
+                out_weights=reinterpret_cast<const int8_t *>(p);
+                return true;
+            }
+    };
+
+    Network NNUE;
+
+    int nnue_index(int side, int king, char piece, int sq){
+        if(side==1){
+            sq^=56;
+            king^=56;
+        }
+        int type;
+        switch(piece){
+            case 'P': case 'p': type=0; break;
+            case 'N': case 'n': type=1; break;
+            case 'B': case 'b': type=2; break;
+            case 'R': case 'r': type=3; break;
+            default: type=4; break;
+        }
+        bool own=(piece>='A' && piece<='Z')==(side==0);
+        return ((king*10 + type + (own ? 0 : 5))<<6) + sq;
+    }
+
+    // out = in - sub1 (- sub2) + add, over one side's 256 values
+    void nnue_apply(const int16_t *in, int16_t *out, const int16_t *add,
+                    const int16_t *sub1, const int16_t *sub2){
+#if defined(__AVX2__)
+        for(int i=0; i<NNUE_HALF; i+=16){
+            __m256i v=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in+i));
+            v=_mm256_sub_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sub1+i)));
+            if(sub2) v=_mm256_sub_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sub2+i)));
+            v=_mm256_add_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(add+i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out+i), v);
+        }
+#else
+        for(int i=0; i<NNUE_HALF; i++){
+            int v=in[i]-sub1[i]+add[i];
+            if(sub2) v-=sub2[i];
+            out[i]=static_cast<int16_t>(v);
+        }
+#endif
+    }
+
+    void nnue_refresh(Accumulator &acc, int side, const char a[8][8]){
+        int16_t *v=acc.v[side];
+        memcpy(v, NNUE.ft_bias, sizeof(acc.v[side]));
+        for(int sq=0; sq<64; sq++){
+            char p=a[sq>>3][sq&7];
+            if(p=='.' || p=='K' || p=='k') continue;
+            const int16_t *row=NNUE.ft_weights+NNUE_HALF*nnue_index(side, acc.king[side], p, sq);
+            for(int i=0; i<NNUE_HALF; i++) v[i]+=row[i];
+        }
+    }
+
+    void nnue_refresh(Accumulator &acc, const char a[8][8]){
+        acc.king[0]=acc.king[1]=-1;
+        for(int sq=0; sq<64; sq++){
+            if(a[sq>>3][sq&7]=='K') acc.king[0]=sq;
+            if(a[sq>>3][sq&7]=='k') acc.king[1]=sq;
+        }
+        acc.king_lost=acc.king[0]<0 || acc.king[1]<0;
+        if(acc.king_lost) return;
+        nnue_refresh(acc, 0, a);
+        nnue_refresh(acc, 1, a);
+    }
+
+    void nnue_update(const Accumulator &parent, Accumulator &child, char p, char c,
+                     int from, int to, int taken, const char a[8][8]){
+        // `a` is the board after the move, c what was taken on `taken`
+        // (to, but for en passant)
+        child.king[0]=parent.king[0];
+        child.king[1]=parent.king[1];
+        child.king_lost=parent.king_lost || c=='K' || c=='k';
+        if(child.king_lost) return;
+        if(p=='K') child.king[0]=to;
+        if(p=='k') child.king[1]=to;
+        for(int side=0; side<2; side++){
+            if(p==(side==0 ? 'K' : 'k')){
+                nnue_refresh(child, side, a);
+                continue;
+            }
+            if(p=='K' || p=='k'){
+                // the other king moved: not an input on this side
+                if(c=='.') memcpy(child.v[side], parent.v[side], sizeof(child.v[side]));
+                else{
+                    const int16_t *cap=NNUE.ft_weights+NNUE_HALF*nnue_index(side, child.king[side], c, taken);
+                    for(int i=0; i<NNUE_HALF; i++) child.v[side][i]=parent.v[side][i]-cap[i];
+                }
+                continue;
+            }
+            int k=child.king[side];
+            const int16_t *add=NNUE.ft_weights+NNUE_HALF*nnue_index(side, k, p, to);
+            const int16_t *sub=NNUE.ft_weights+NNUE_HALF*nnue_index(side, k, p, from);
+            const int16_t *cap=c=='.' ? NULL : NNUE.ft_weights+NNUE_HALF*nnue_index(side, k, c, taken);
+            nnue_apply(parent.v[side], child.v[side], add, sub, cap);
+        }
+    }
+
+    void nnue_clip(const int16_t *in, uint8_t *out, int n){
+#if defined(__AVX2__)
+        const __m256i zero=_mm256_setzero_si256();
+        for(int i=0; i<n; i+=32){
+            __m256i lo=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in+i));
+            __m256i hi=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in+i+16));
+            // packs saturates to -128..127 but works per 128 bit lane
+            __m256i v=_mm256_max_epi8(_mm256_packs_epi16(lo, hi), zero);
+            v=_mm256_permute4x64_epi64(v, 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out+i), v);
+        }
+#else
+        for(int i=0; i<n; i++) out[i]=in[i]<0 ? 0 : (in[i]>127 ? 127 : in[i]);
+#endif
+    }
+
+    int32_t nnue_dot(const uint8_t *in, const int8_t *w, int n){
+        // n is a multiple of 32
+#if defined(__AVX2__)
+        const __m256i ones=_mm256_set1_epi16(1);
+        __m256i sum=_mm256_setzero_si256();
+        for(int i=0; i<n; i+=32){
+            __m256i x=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in+i));
+            __m256i y=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(w+i));
+            // inputs are at most 127, so the pairwise sums can't saturate
+            sum=_mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, y), ones));
+        }
+        __m128i s=_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s=_mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s=_mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        return _mm_cvtsi128_si32(s);
+#elif defined(__SSSE3__)
+        const __m128i ones=_mm_set1_epi16(1);
+        __m128i sum=_mm_setzero_si128();
+        for(int i=0; i<n; i+=16){
+            __m128i x=_mm_loadu_si128(reinterpret_cast<const __m128i *>(in+i));
+            __m128i y=_mm_loadu_si128(reinterpret_cast<const __m128i *>(w+i));
+            sum=_mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, y), ones));
+        }
+        sum=_mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum=_mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        return _mm_cvtsi128_si32(sum);
+#else
+        int32_t sum=0;
+        for(int i=0; i<n; i++) sum+=in[i]*w[i];
+        return sum;
+#endif
+    }
+
+    void nnue_dense(const uint8_t *in, int n, const int8_t *w, const int32_t *bias, uint8_t *out){
+        for(int o=0; o<NNUE_HIDDEN; o++){
+            int32_t v=(bias[o]+nnue_dot(in, w+o*n, n))>>NNUE_SHIFT;
+            out[o]=v<0 ? 0 : (v>127 ? 127 : v);
+        }
+    }
+
+    int nnue_evaluate(const Accumulator &acc, bool white_to_move){
+        // centipawns for the side to move
+        alignas(32) uint8_t input[2*NNUE_HALF];
+        alignas(32) uint8_t h1[NNUE_HIDDEN], h2[NNUE_HIDDEN];
+        int us=white_to_move ? 0 : 1;
+        nnue_clip(acc.v[us], input, NNUE_HALF);
+        nnue_clip(acc.v[1-us], input+NNUE_HALF, NNUE_HALF);
+        nnue_dense(input, 2*NNUE_HALF, NNUE.l1_weights, NNUE.l1_bias, h1);
+        nnue_dense(h1, NNUE_HIDDEN, NNUE.l2_weights, NNUE.l2_bias, h2);
+        return (*NNUE.out_bias+nnue_dot(h2, NNUE.out_weights, NNUE_HIDDEN))/NNUE_SCALE;
+    }
+}
+
+#define _nnue_h
+#endif
@@ -0,0 +1,246 @@
+#ifndef _pgn_h
+
+#include <string.h>
+#include <istream>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "board.h"
+
+namespace bigdumb{
+    class PgnGame{
+        public:
+            std::map<std::string, std::string> tags;
+            std::vector<std::string> moves;
+            std::string result;
+
+            void clear(){
+                tags.clear();
+                moves.clear();
+                result="*";
+            }
+
+            std::string start_fen() const {
+                std::map<std::string, std::string>::const_iterator fen=tags.find("FEN");
+                if(fen!=tags.end()) return fen->second;
+                return "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+            }
+    };
+
+    bool is_result(const std::string &t){
+        return t=="1-0" || t=="0-1" || t=="1/2-1/2" || t=="*";
+    }
+
+    void tokenize_movetext(const char *text, const char *end, PgnGame &game){
+        // drops comments, variations, NAGs and move numbers, keeping
+        // only the SAN moves of the main line
+        int nesting=0;
+        const char *i=text;
+        while(i<end){
+            char c=*i;
+            if(c=='{' || c==';'){
+                const char *close=static_cast<const char *>(memchr(i, c=='{' ? '}' : '\n', end-i));
+                i=close ? close+1 : end;
+                continue;
+            }
+            if(c=='('){ nesting++; i++; continue; }
+            if(c==')'){ if(nesting) nesting--; i++; continue; }
+            if(isspace(static_cast<unsigned char>(c))){ i++; continue; }
+            const char *start=i;
+            while(i<end && !isspace(static_cast<unsigned char>(*i))
+                    && *i!='{' && *i!='(' && *i!=')' && *i!=';') i++;
+            if(nesting) continue;
+            std::string token(start, i-start);
+            if(token[0]=='$') continue;
+            if(is_result(token)){
+                game.result=token;
+                continue;
+            }
+            // "12." / "12..." possibly glued to the move: "12.e4"
+            size_t k=0;
+            while(k<token.length() && isdigit(static_cast<unsigned char>(token[k]))) k++;
+            if(k<token.length() && token[k]=='.' && k>0){
+                while(k<token.length() && token[k]=='.') k++;
+                token=token.substr(k);
+            }
+            if(!token.empty()) game.moves.push_back(token);
+        }
+    }
+
+    void tokenize_movetext(const std::string &text, PgnGame &game){
+        tokenize_movetext(text.data(), text.data()+text.length(), game);
+    }
+
+    void parse_tag(const char *line, const char *end, PgnGame &game){
+        // [Name "value"]
+        const char *open=static_cast<const char *>(memchr(line, '[', end-line));
+        const char *q1=static_cast<const char *>(memchr(line, '"', end-line));
+        if(!open || !q1) return;
+        const char *q2=end;
+        while(q2>q1+1 && q2[-1]!='"') q2--;
+        if(q2<=q1+1) return;
+        const char *sp=open+1;
+        while(sp<q1 && !isspace(static_cast<unsigned char>(*sp))) sp++;
+        if(sp==open+1 || sp>=q1) return;
+        game.tags[std::string(open+1, sp)]=std::string(q1+1, q2-1);
+    }
+
+    bool read_pgn_game(std::istream &in, PgnGame &game){
+        game.clear();
+        std::string line, text;
+        bool in_moves=false, any=false;
+        while(in.peek()!=EOF){
+            if(in_moves && in.peek()=='[') break;
+            std::getline(in, line);
+            if(!line.empty() && line[line.length()-1]=='\r') line.erase(line.length()-1);
+            size_t first=line.find_first_not_of(" \t");
+            if(first==std::string::npos){
+                if(in_moves) break;
+                continue;
+            }
+            if(line[first]=='[' && !in_moves){
+                parse_tag(line.data(), line.data()+line.length(), game);
+                any=true;
+                continue;
+            }
+            in_moves=true;
+            any=true;
+            text+=line+"\n";
+        }
+        if(!any) return false;
+        tokenize_movetext(text, game);
+        if(game.tags.count("Result") && is_result(game.tags["Result"])) game.result=game.tags["Result"];
+        return true;
+    }
+
+    // one game of a PGN held in memory, as pointers into it: the tag
+    // pairs are [tags, movetext) and the moves [movetext, end)
+    class PgnSpan{
+        public:
+            const char *tags;
+            const char *movetext;
+            const char *end;
+    };
+
+    // splits PGN text, a mapped file say, into games without copying it,
+    // by the same rules as read_pgn_game: a game ends at the tags of the
+    // next one or at a blank line after its moves.
+    class PgnReader{
+        public:
+            const char *at;
+            const char *end;
+
+            PgnReader(const char *begin, const char *finish){
+                at=begin;
+                end=finish;
+            }
+
+            bool next(PgnSpan &game){
+                bool in_moves=false, any=false;
+                game.tags=game.movetext=game.end=at;
+                while(at<end){
+                    const char *eol=static_cast<const char *>(memchr(at, '\n', end-at));
+                    const char *next_line=eol ? eol+1 : end;
+                    const char *first=at;
+                    while(first<next_line && isspace(static_cast<unsigned char>(*first))) first++;
+                    if(first==next_line){
+                        at=next_line;
+                        if(in_moves) break;
+                        continue;
+                    }
+                    if(*first=='['){
+                        if(in_moves) break;
+                        if(!any) game.tags=at;
+                    }
+                    else if(!in_moves){
+                        if(!any) game.tags=at;
+                        game.movetext=at;
+                        in_moves=true;
+                    }
+                    any=true;
+                    at=next_line;
+                    game.end=at;
+                }
+                if(!any) return false;
+                if(!in_moves) game.movetext=game.end;
+                return true;
+            }
+    };
+
+    void parse_pgn_game(const PgnSpan &span, PgnGame &game){
+        game.clear();
+        const char *line=span.tags;
+        while(line<span.movetext){
+            const char *eol=static_cast<const char *>(memchr(line, '\n', span.movetext-line));
+            const char *next_line=eol ? eol+1 : span.movetext;
+            parse_tag(line, next_line, game);
+            line=next_line;
+        }
+        tokenize_movetext(span.movetext, span.end, game);
+        if(game.tags.count("Result") && is_result(game.tags["Result"])) game.result=game.tags["Result"];
+    }
+
+    bool resolve_san(Board &board, std::string san, std::string &coord){
+        // turns a SAN move into the coordinate move Board::move(std::string)
+        // takes, or fails if no legal move matches.
+        while(!san.empty() && (san[san.length()-1]=='+' || san[san.length()-1]=='#'
+                || san[san.length()-1]=='!' || san[san.length()-1]=='?'))
+            san.erase(san.length()-1);
+        bool white=board.half_move%2==0;
+        if(san=="O-O" || san=="0-0"){
+            coord=white ? "e1g1" : "e8g8";
+            return board.a[white ? 7 : 0][4]==(white ? 'K' : 'k');
+        }
+        if(san=="O-O-O" || san=="0-0-0"){
+            coord=white ? "e1c1" : "e8c8";
+            return board.a[white ? 7 : 0][4]==(white ? 'K' : 'k');
+        }
+        char promotion=0;
+        size_t eq=san.find('=');
+        if(eq!=std::string::npos && eq+1<san.length()){
+            promotion=tolower(san[eq+1]);
+            san=san.substr(0, eq);
+        }
+        else if(san.length()>2 && isupper(static_cast<unsigned char>(san[san.length()-1]))
+                && islower(static_cast<unsigned char>(san[0]))){
+            // "e8Q"
+            promotion=tolower(san[san.length()-1]);
+            san.erase(san.length()-1);
+        }
+        if(san.length()<2) return false;
+        int to=8*('8'-san[san.length()-1])+san[san.length()-2]-'a';
+        if(to<0 || to>63) return false;
+        char piece=isupper(static_cast<unsigned char>(san[0])) ? san[0] : 'P';
+        std::list<ChessMove> moves=board.legal_moves();
+        for(std::list<ChessMove>::iterator i=moves.begin(); i!=moves.end(); i++){
+            int from=(*i).from;
+            if((*i).to!=to || toupper(board.a[from>>3][from&7])!=piece) continue;
+            std::string mine=board.san(from, to);
+            size_t e=mine.find('=');
+            if(e!=std::string::npos) mine=mine.substr(0, e);
+            // some writers leave out the 'x' or add needless disambiguation
+            std::string plain_mine, plain_san;
+            for(size_t k=0; k<mine.length(); k++) if(mine[k]!='x') plain_mine+=mine[k];
+            for(size_t k=0; k<san.length(); k++) if(san[k]!='x') plain_san+=san[k];
+            bool match=plain_mine==plain_san;
+            if(!match && plain_san.length()>plain_mine.length() && piece!='P'){
+                // "Ng1f3": check the extra characters describe `from`
+                std::string extra=plain_san.substr(1, plain_san.length()-3);
+                match=true;
+                for(size_t k=0; k<extra.length(); k++){
+                    if(extra[k]>='a' && extra[k]<='h' && extra[k]-'a'!=(from&7)) match=false;
+                    else if(extra[k]>='1' && extra[k]<='8' && '8'-extra[k]!=(from>>3)) match=false;
+                }
+            }
+            if(!match) continue;
+            coord=board.coord(from, to);
+            if(promotion && coord.length()==5) coord[4]=promotion;
+            return true;
+        }
+        return false;
+    }
+}
+
+#define _pgn_h
+#endif
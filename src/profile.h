@@ -0,0 +1,160 @@
+#ifndef _profile_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILE_RDTSC
+#endif
+
+// where a move's time goes, subsystem by subsystem. compiled in with
+// -DHOT_PROFILE; without the define the PROFILE() calls in the engine
+// are not compiled at all.
+//
+// PROFILE(slot) starts a timer that stops at the end of its scope, or
+// at PROFILE_END(), and adds its cycles (the time stamp counter where
+// there is one, steady_clock nanoseconds elsewhere) and one call to the
+// slot, under whichever slot was running when it started. every thread
+// has its own fixed table, so the timers share nothing. think() logs
+// its thread's table as a tree after each move and clears it, and
+// bench prints the whole run's.
+
+#define PROF_NONE 0
+#define PROF_SEARCH 1
+#define PROF_COPY 2
+#define PROF_GEN 3
+#define PROF_BITBOARDS 4
+#define PROF_ADD_MOVES 5
+#define PROF_SORT 6
+#define PROF_ATTACKS 7
+#define PROF_EVAL 8
+#define PROF_SLOTS 9
+
+const char *PROFILE_NAMES[PROF_SLOTS]={
+    "", "search", "board copy", "move generation", "recompute_bitboards",
+    "add_move_from_bitmap", "list sort", "attack tables", "evaluate"
+};
+
+namespace bigdumb{
+    inline uint64_t profile_clock(){
+#ifdef PROFILE_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    class Profile{
+        public:
+            // by the slot that was running, then the slot itself
+            uint64_t cycles[PROF_SLOTS][PROF_SLOTS];
+            uint64_t calls[PROF_SLOTS][PROF_SLOTS];
+            int current;
+
+            Profile(){
+                clear();
+            }
+
+            void clear(){
+                memset(cycles, 0, sizeof(cycles));
+                memset(calls, 0, sizeof(calls));
+                current=PROF_NONE;
+            }
+
+            std::vector<std::string> report() const {
+                // one line per slot, children indented under the slot
+                // they ran in, each with what it spent outside them
+                std::vector<std::string> lines;
+                uint64_t total=0;
+                for(int s=1; s<PROF_SLOTS; s++) total+=cycles[PROF_NONE][s];
+                char line[128];
+#ifdef PROFILE_RDTSC
+                snprintf(line, sizeof(line), "%-30s %14s %7s %12s", "profile", "cycles", "share", "calls");
+#else
+                snprintf(line, sizeof(line), "%-30s %14s %7s %12s", "profile", "ns", "share", "calls");
+#endif
+                lines.push_back(line);
+                rows(lines, PROF_NONE, 0, total > 0 ? total : 1);
+                return lines;
+            }
+
+            void rows(std::vector<std::string> &lines, int parent, int level, uint64_t total) const {
+                uint64_t inside=0;
+                bool any=false;
+                char line[128];
+                for(int s=1; s<PROF_SLOTS; s++){
+                    if(!calls[parent][s]) continue;
+                    std::string name=std::string(2*level, ' ')+PROFILE_NAMES[s];
+                    snprintf(line, sizeof(line), "%-30s %14llu %6.1f%% %12llu", name.c_str(),
+                             static_cast<unsigned long long>(cycles[parent][s]), 100.0*cycles[parent][s]/total,
+                             static_cast<unsigned long long>(calls[parent][s]));
+                    lines.push_back(line);
+                    inside+=cycles[parent][s];
+                    any=true;
+                    // children are kept by the slot they ran in, not the
+                    // whole path, so the depth is what ends this
+                    if(level<PROF_SLOTS) rows(lines, s, level+1, total);
+                }
+                if(parent==PROF_NONE || !any) return;
+                uint64_t own=0;
+                for(int p=0; p<PROF_SLOTS; p++) own+=cycles[p][parent];
+                own=own>inside ? own-inside : 0;
+                std::string name=std::string(2*level, ' ')+"(self)";
+                snprintf(line, sizeof(line), "%-30s %14llu %6.1f%%", name.c_str(),
+                         static_cast<unsigned long long>(own), 100.0*own/total);
+                lines.push_back(line);
+            }
+    };
+
+    thread_local Profile PROFILE_TABLE;
+
+    class ScopedTimer{
+        public:
+            int slot;
+            int parent;
+            uint64_t start;
+            bool running;
+
+            ScopedTimer(int s){
+                slot=s;
+                parent=PROFILE_TABLE.current;
+                PROFILE_TABLE.current=s;
+                running=true;
+                start=profile_clock();
+            }
+
+            ~ScopedTimer(){
+                stop();
+            }
+
+            void stop(){
+                if(!running) return;
+                uint64_t elapsed=profile_clock()-start;
+                Profile &p=PROFILE_TABLE;
+                p.cycles[parent][slot]+=elapsed;
+                p.calls[parent][slot]++;
+                p.current=parent;
+                running=false;
+            }
+    };
+}
+
+#ifdef HOT_PROFILE
+#define PROFILE(slot) bigdumb::ScopedTimer profile_timer_(slot)
+#define PROFILE_END() profile_timer_.stop()
+#else
+#define PROFILE(slot)
+#define PROFILE_END()
+#endif
+
+#define _profile_h
+#endif
@@ -1,4 +1,11 @@
 
+int PAWN_VALUE = 100;
+int KNIGHT_VALUE = 320;
+int BISHOP_VALUE = 330;
+int ROOK_VALUE = 500;
+int QUEEN_VALUE = 900;
+int KING_VALUE = 20000;
+
 int PAWN_PSQ[64]
 ={
  0,  0,  0,  0,  0,  0,  0,  0,
@@ -0,0 +1,146 @@
+#ifndef _server_h
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "session.h"
+
+namespace bigdumb{
+    // a session plus the lines waiting for it. `queued` means it is on
+    // the ready list or being run, so only one thread ever handles a
+    // session and its commands stay in order.
+    class ServerSession{
+        public:
+            std::string id;
+            Session session;
+            std::deque<std::string> inbox;
+            bool queued;
+            bool closed;
+
+            ServerSession(std::string name, std::function<void(const std::string &)> reply)
+                : id(name), session(reply, true){
+                queued=false;
+                closed=false;
+            }
+    };
+
+    // many games in one process over a line multiplexer:
+    //
+    //   in:  <session> <xboard command>
+    //   out: <session> <xboard reply>
+    //
+    // a session starts with its first line and ends with its `quit`.
+    // a fixed pool of threads takes ready sessions in turn, one command
+    // at a time, so a long search only holds up its own game.
+    class Server{
+        public:
+            std::map<std::string, std::shared_ptr<ServerSession> > sessions;
+            std::deque<std::shared_ptr<ServerSession> > ready;
+            std::mutex lock;
+            std::mutex out_lock;
+            std::condition_variable wake;
+            std::condition_variable idle;
+            std::ostream &out;
+            int running;
+            bool done;
+            // default time per move in ms for sessions that don't set one
+            int movetime;
+
+            Server(std::ostream &o, int ms) : out(o){
+                running=0;
+                done=false;
+                movetime=ms;
+            }
+
+            void send(const std::string &id, const std::string &line){
+                std::lock_guard<std::mutex> guard(out_lock);
+                out << id << " " << line << std::endl;
+            }
+
+            void submit(const std::string &id, const std::string &line){
+                std::lock_guard<std::mutex> guard(lock);
+                std::shared_ptr<ServerSession> &s=sessions[id];
+                if(!s){
+                    s=std::make_shared<ServerSession>(id, [this, id](const std::string &reply){
+                        send(id, reply);
+                    });
+                    s->session.movetime=movetime;
+                    s->session.default_movetime=movetime;
+                    LOG_INFO("session " << id << " opened");
+                }
+                s->inbox.push_back(line);
+                if(!s->queued){
+                    s->queued=true;
+                    ready.push_back(s);
+                    wake.notify_one();
+                }
+            }
+
+            void work(){
+                while(true){
+                    std::shared_ptr<ServerSession> s;
+                    std::string line;
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        while(ready.empty() && !done) wake.wait(guard);
+                        if(ready.empty()) return;
+                        s=ready.front();
+                        ready.pop_front();
+                        line=s->inbox.front();
+                        s->inbox.pop_front();
+                        running++;
+                    }
+                    bool open=s->session.command(line);
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        running--;
+                        if(!open){
+                            s->closed=true;
+                            s->inbox.clear();
+                            sessions.erase(s->id);
+                            LOG_INFO("session " << s->id << " closed");
+                        }
+                        // back of the line, so busy sessions take turns
+                        if(!s->inbox.empty()) ready.push_back(s);
+                        else s->queued=false;
+                        if(ready.empty() && running==0) idle.notify_all();
+                        else wake.notify_one();
+                    }
+                }
+            }
+
+            void run(std::istream &in, int threads){
+                precomputeAll();
+                if(threads<1) threads=1;
+                std::vector<std::thread> pool;
+                for(int t=0; t<threads; t++) pool.push_back(std::thread(&Server::work, this));
+                std::string line;
+                while(std::getline(in, line)){
+                    if(!line.empty() && line[line.length()-1]=='\r') line.erase(line.length()-1);
+                    std::istringstream words(line);
+                    std::string id, rest;
+                    if(!(words >> id)) continue;
+                    std::getline(words, rest);
+                    submit(id, rest);
+                }
+                // finish what was asked before closing
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    while(!ready.empty() || running) idle.wait(guard);
+                    done=true;
+                    wake.notify_all();
+                }
+                for(size_t t=0; t<pool.size(); t++) pool[t].join();
+                LOG_INFO("server done, " << sessions.size() << " sessions left open");
+            }
+    };
+}
+
+#define _server_h
+#endif
@@ -0,0 +1,323 @@
+#ifndef _session_h
+
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.h"
+#include "analyze.h"
+#include "mate.h"
+#include "mcts.h"
+
+namespace bigdumb{
+    bool is_file(char c){
+        return c>='a' && c<='h';
+    }
+
+    bool is_rank(char c){
+        return c>='1' && c<='8';
+    }
+
+    bool is_chess_move(std::string s){
+        return (s.length()==4 || s.length()==5)
+            && is_file(s[0]) && is_rank(s[1]) && is_file(s[2]) && is_rank(s[3]);
+    }
+
+    // one xboard conversation: the game, its settings, and what it has
+    // said it wants. tal runs one over stdin; the server runs many,
+    // each fed its own lines, sharing the move tables and the
+    // transposition table.
+    class Session{
+        public:
+            Board board;
+            // positions before each move, for undo
+            std::vector<Board> history;
+            bool force_mode;
+            bool analyze_mode;
+            Analysis analysis;
+            // analyze mode's line count (xboard's MultiPV option)
+            int multipv;
+            // moves the mate solver looks for beside each search, 0 for
+            // none (xboard's MateSearch option)
+            int mate_moves;
+            // MCTS_PUCT or MCTS_UCT to pick moves by tree search
+            // instead of alpha-beta (xboard's Search option), and the
+            // threads it plays out on (cores)
+            int search_rule;
+            int cores;
+            MctsSearch mcts;
+            // most plies to search (sd), a fixed time per move in ms
+            // (st), and what is left on the engine's clock in
+            // centiseconds (time); 0 means unset
+            int depth;
+            int movetime;
+            // what movetime goes back to on new, the server's per-move
+            // budget for its sessions
+            int default_movetime;
+            long long clock;
+            // server sessions can't start threads of their own or
+            // change anything shared
+            bool server;
+            std::function<void(const std::string &)> reply;
+
+            Session(std::function<void(const std::string &)> out, bool in_server){
+                reply=out;
+                server=in_server;
+                force_mode=false;
+                analyze_mode=false;
+                multipv=1;
+                mate_moves=0;
+                search_rule=MCTS_OFF;
+                cores=1;
+                depth=ROOT_DEPTH;
+                movetime=0;
+                default_movetime=0;
+                clock=0;
+            }
+
+            ~Session(){
+                analysis.stop();
+            }
+
+            bool stops_analysis(const std::string &cmd){
+                // anything else (".", "post", "time" ...) leaves it running
+                return is_chess_move(cmd) || cmd=="quit" || cmd=="new" || cmd=="setboard"
+                    || cmd=="undo" || cmd=="remove" || cmd=="exit" || cmd=="analyze"
+                    || cmd=="option" || cmd=="memory" || cmd=="go" || cmd=="force";
+            }
+
+            int budget(){
+                // ms for the next move, or 0 to search to depth
+                if(movetime) return movetime;
+                if(clock) return static_cast<int>(clock*10/30);
+                return 0;
+            }
+
+            std::string think(){
+                // the tree search plays out for the whole budget, or a
+                // fixed number of playouts; it has no depth
+                if(search_rule!=MCTS_OFF) return mcts.think(board, search_rule, cores, budget());
+                return board.think(depth, budget());
+            }
+
+            void play(){
+                history.push_back(board);
+                if(!mate_moves || server){
+                    answer(think());
+                    return;
+                }
+                // the solver gets a spare thread while the search runs;
+                // a mate it proves in time beats whatever the search picked
+                Board before=board;
+                MateSolver solver;
+                int found=-1;
+                ChessMove best;
+                std::string line;
+                std::thread spare([&](){ found=solver.solve(before, mate_moves, best, line); });
+                std::string played=think();
+                solver.stop=true;
+                spare.join();
+                if(found>0){
+                    std::string mate=before.coord(best.from, best.to);
+                    LOG_INFO("mate in " << found << " found in " << solver.nodes << " nodes: " << line);
+                    if(mate!=played){
+                        board=before;
+                        board.move(mate);
+                        played=mate;
+                    }
+                }
+                answer(played);
+            }
+
+            void answer(const std::string &played){
+                // a game that is over gets its result instead of a move
+                if(!played.empty()){
+                    reply("move "+played);
+                    return;
+                }
+                history.pop_back();
+                bool white=board.half_move%2==0;
+                if(!board.in_check(white)) reply("1/2-1/2 {Stalemate}");
+                else reply(white ? "0-1 {Black mates}" : "1-0 {White mates}");
+            }
+
+            void mate(int n){
+                // mate <n>: prove or refute a mate in n for the side to move
+                MateSolver solver;
+                ChessMove best;
+                std::string line;
+                std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+                int found=solver.solve(board, n, best, line);
+                long long ms=std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now()-start).count();
+                std::ostringstream out;
+                if(found>0) out << "mate in " << found << ": " << line;
+                else if(found==0) out << "no mate in " << n;
+                else out << "no result for mate in " << n << " within " << solver.max_nodes << " nodes";
+                out << " (" << solver.nodes << " nodes, " << ms << " ms)";
+                reply(out.str());
+            }
+
+            bool accepts(const std::string &crd){
+                // whether crd is a legal move here. Board::move(string)
+                // gives up on the engine for anything it can't play, and
+                // in the server that takes every other game with it.
+                // castling isn't generated, so it is checked apart
+                if(crd.length()==5 && !board.valid_piece(crd[4])) return false;
+                int from=8*('8'-crd[1])+crd[0]-'a', to=8*('8'-crd[3])+crd[2]-'a';
+                bool white=board.half_move%2==0;
+                char king=white ? 'K' : 'k';
+                int home=white ? 60 : 4;
+                if(crd.length()==4 && from==home && (to==home+2 || to==home-2)
+                        && board.a[from>>3][from&7]==king && (white ? board.white_can_castle : board.black_can_castle)){
+                    int rook=to>from ? home+3 : home-4;
+                    for(int sq=std::min(from, rook)+1; sq<std::max(from, rook); sq++)
+                        if(board.a[sq>>3][sq&7]!='.') return false;
+                    return board.a[rook>>3][rook&7]==(white ? 'R' : 'r');
+                }
+                std::list<ChessMove> moves=board.legal_moves();
+                for(std::list<ChessMove>::iterator i=moves.begin(); i!=moves.end(); i++)
+                    if((*i).from==from && (*i).to==to) return true;
+                return false;
+            }
+
+            // handles one line from the GUI; false once it says quit
+            bool command(const std::string &line){
+                std::istringstream in(line);
+                std::string cmd, rest;
+                if(!(in >> cmd)) return true;
+                std::getline(in, rest);
+                if(stops_analysis(cmd)) analysis.stop();
+                if(cmd=="quit") return false;
+                LOG_INFO("winboard: " << line);
+                if(is_chess_move(cmd)){
+                    if(!accepts(cmd)){
+                        LOG_INFO("illegal move " << cmd);
+                        reply("Illegal move: "+cmd);
+                        return true;
+                    }
+                    LOG_DEBUG(cmd << " is a valid move");
+                    history.push_back(board);
+                    board.move(cmd);
+                    if(!force_mode && !analyze_mode) play();
+                }
+                else if(cmd=="xboard"){
+                    reply("feature myname=\"bigdumb\"");
+                    reply("feature setboard=1");
+                    reply("feature ping=1");
+                    reply(server ? "feature analyze=0" : "feature analyze=1");
+                    if(!server){
+                        reply("feature memory=1");
+                        reply("feature option=\"MultiPV -spin 1 1 64\"");
+                        reply("feature option=\"MateSearch -spin 0 0 10\"");
+                        reply("feature option=\"Search -combo *AlphaBeta /// PUCT /// UCT\"");
+                        reply("feature smp=1");
+                    }
+                    reply("feature done=1");
+                    precomputeAll();
+                    // position keys need the tables above
+                    board=Board();
+                    reply("sent features. init bitboards ready");
+                }
+                else if(cmd=="new"){
+                    LOG_INFO("setting up a new game...");
+                    board=Board();
+                    history.clear();
+                    force_mode=false;
+                    depth=ROOT_DEPTH;
+                    movetime=default_movetime;
+                    clock=0;
+                    // other sessions are still using the table
+                    if(!server){
+                        TT.clear();
+                        if(!LEARN_FILE.empty()) LEARN.seed(TT);
+                    }
+                }
+                else if(cmd=="setboard"){
+                    LOG_INFO("setting up " << rest);
+                    if(!board.set_fen(rest)) reply("tellusererror Illegal position");
+                    history.clear();
+                }
+                else if(cmd=="undo" || cmd=="remove"){
+                    // remove takes back a move for each side
+                    for(int n=(cmd=="undo" ? 1 : 2); n>0 && !history.empty(); n--){
+                        board=history.back();
+                        history.pop_back();
+                    }
+                }
+                else if(cmd=="ping") reply("pong"+rest);
+                else if(cmd=="mate"){
+                    int n=atoi(rest.c_str());
+                    mate(n>0 ? n : 1);
+                }
+                else if(cmd=="sd"){
+                    int d=atoi(rest.c_str());
+                    if(d>0) depth=d<MAX_PLY ? d : MAX_PLY-1;
+                }
+                else if(cmd=="st") movetime=1000*atoi(rest.c_str());
+                else if(cmd=="time") clock=atoll(rest.c_str());
+                else if(cmd=="memory"){
+                    int mb=atoi(rest.c_str());
+                    if(!server && mb>0){
+                        TT.resize(mb);
+                        if(!LEARN_FILE.empty()) LEARN.seed(TT);
+                    }
+                }
+                else if(cmd=="option"){
+                    // option MultiPV=3
+                    size_t eq=rest.find('=');
+                    if(rest.find("MultiPV")!=std::string::npos && eq!=std::string::npos){
+                        multipv=atoi(rest.c_str()+eq+1);
+                        if(multipv<1) multipv=1;
+                    }
+                    if(rest.find("MateSearch")!=std::string::npos && eq!=std::string::npos){
+                        mate_moves=atoi(rest.c_str()+eq+1);
+                        if(mate_moves<0) mate_moves=0;
+                    }
+                    // option Search=PUCT; server sessions keep to alpha-beta
+                    std::string name=rest.substr(0, eq);
+                    name.erase(0, name.find_first_not_of(' '));
+                    if(name=="Search" && eq!=std::string::npos && !server){
+                        std::string rule=rest.substr(eq+1);
+                        if(rule.find("PUCT")!=std::string::npos) search_rule=MCTS_PUCT;
+                        else if(rule.find("UCT")!=std::string::npos) search_rule=MCTS_UCT;
+                        else search_rule=MCTS_OFF;
+                    }
+                }
+                else if(cmd=="cores"){
+                    // threads for the tree search; alpha-beta runs on one
+                    cores=atoi(rest.c_str());
+                    if(cores<1) cores=1;
+                }
+                else if(cmd=="analyze"){
+                    if(server) reply("Error (not available in server mode): analyze");
+                    else{
+                        analyze_mode=true;
+                        LOG_DEBUG("analyze mode enabled");
+                    }
+                }
+                else if(cmd=="exit"){
+                    analyze_mode=false;
+                    LOG_DEBUG("analyze mode disabled");
+                }
+                else if(cmd=="force"){
+                    force_mode=true;
+                    LOG_DEBUG("force mode enabled");
+                }
+                else if(cmd=="go"){
+                    force_mode=false;
+                    LOG_DEBUG("force mode disabled");
+                    LOG_INFO("engine playing as " << (board.half_move%2==0 ? "white" : "black"));
+                    // make a new move.
+                    play();
+                }
+                if(analyze_mode && !analysis.running()) analysis.start(board, multipv, reply);
+                return true;
+            }
+    };
+}
+
+#define _session_h
+#endif
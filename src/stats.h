@@ -0,0 +1,128 @@
+#ifndef _stats_h
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#define MAX_PLY 64
+
+// where think() appends one JSON line per move; empty turns it off.
+std::string TELEMETRY_FILE = "";
+
+namespace bigdumb{
+    class SearchStats{
+        public:
+            long long nodes;
+            long long qnodes;
+            // cutoffs, and how many of them came from the first move tried
+            long long fail_high;
+            long long fail_high_first;
+            // transposition table lookups, how many found the position,
+            // and how many of those ended the node
+            long long tt_probes;
+            long long tt_hits;
+            long long tt_cutoffs;
+            // frontier nodes cut on the static score, nodes razored into
+            // quiescence, and quiet moves skipped as futile
+            long long rfp_pruned;
+            long long razored;
+            long long futility_pruned;
+            // quiescence captures skipped as losing material
+            long long bad_captures;
+            // cutoffs by a killer move, and all cutoffs that came before
+            // the quiet moves had to be generated
+            long long killer_cutoffs;
+            long long early_cutoffs;
+            // nodes in check searched a ply deeper
+            long long check_extensions;
+            long long ply_nodes[MAX_PLY];
+            // wall time of each search() call, by depth
+            double iteration_ms[MAX_PLY];
+            int max_depth;
+
+            SearchStats(){
+                clear();
+            }
+
+            void clear(){
+                nodes=qnodes=fail_high=fail_high_first=0;
+                tt_probes=tt_hits=tt_cutoffs=0;
+                rfp_pruned=razored=futility_pruned=bad_captures=0;
+                killer_cutoffs=early_cutoffs=check_extensions=0;
+                for(int i=0; i<MAX_PLY; i++){
+                    ply_nodes[i]=0;
+                    iteration_ms[i]=0;
+                }
+                max_depth=0;
+            }
+
+            void merge(const SearchStats &o){
+                nodes+=o.nodes;
+                qnodes+=o.qnodes;
+                fail_high+=o.fail_high;
+                fail_high_first+=o.fail_high_first;
+                tt_probes+=o.tt_probes;
+                tt_hits+=o.tt_hits;
+                tt_cutoffs+=o.tt_cutoffs;
+                rfp_pruned+=o.rfp_pruned;
+                razored+=o.razored;
+                futility_pruned+=o.futility_pruned;
+                bad_captures+=o.bad_captures;
+                killer_cutoffs+=o.killer_cutoffs;
+                early_cutoffs+=o.early_cutoffs;
+                check_extensions+=o.check_extensions;
+                for(int i=0; i<MAX_PLY; i++){
+                    ply_nodes[i]+=o.ply_nodes[i];
+                    iteration_ms[i]+=o.iteration_ms[i];
+                }
+                if(o.max_depth>max_depth) max_depth=o.max_depth;
+            }
+
+            double fail_high_first_rate() const {
+                return fail_high ? static_cast<double>(fail_high_first)/fail_high : 0;
+            }
+
+            std::string json() const {
+                // just the counters; callers wrap it with what they know
+                std::ostringstream out;
+                out << "\"nodes\":" << nodes << ",\"qnodes\":" << qnodes
+                    << ",\"fail_high\":" << fail_high
+                    << ",\"fail_high_first\":" << fail_high_first
+                    << ",\"fail_high_first_rate\":" << fail_high_first_rate()
+                    << ",\"tt_probes\":" << tt_probes << ",\"tt_hits\":" << tt_hits
+                    << ",\"tt_cutoffs\":" << tt_cutoffs
+                    << ",\"rfp_pruned\":" << rfp_pruned << ",\"razored\":" << razored
+                    << ",\"futility_pruned\":" << futility_pruned
+                    << ",\"bad_captures\":" << bad_captures
+                    << ",\"killer_cutoffs\":" << killer_cutoffs << ",\"early_cutoffs\":" << early_cutoffs
+                    << ",\"check_extensions\":" << check_extensions;
+                int last=0;
+                for(int i=0; i<MAX_PLY; i++) if(ply_nodes[i]) last=i;
+                out << ",\"ply_nodes\":[";
+                for(int i=0; i<=last; i++) out << (i ? "," : "") << ply_nodes[i];
+                out << "],\"branching\":[";
+                for(int i=0; i<last; i++){
+                    out << (i ? "," : "");
+                    out << (ply_nodes[i] ? static_cast<double>(ply_nodes[i+1])/ply_nodes[i] : 0);
+                }
+                out << "],\"iteration_ms\":[";
+                for(int i=1; i<=max_depth && i<MAX_PLY; i++) out << (i>1 ? "," : "") << iteration_ms[i];
+                out << "]";
+                return out.str();
+            }
+    };
+
+    std::mutex TELEMETRY_LOCK;
+
+    void append_telemetry(std::string line){
+        if(TELEMETRY_FILE.empty()) return;
+        // server sessions finish moves on several threads at once
+        std::lock_guard<std::mutex> guard(TELEMETRY_LOCK);
+        std::ofstream out(TELEMETRY_FILE.c_str(), std::ios::app);
+        out << line << std::endl;
+    }
+}
+
+#define _stats_h
+#endif
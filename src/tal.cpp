@@ -4,71 +4,92 @@
 #include <list>
 #include <limits.h>
 #include <iterator>
+#include <vector>
+#include <mutex>
 #include "debug.h"
 #include "movestore.h"
 #include "board.h"
 #include "moves.h"
+#include "epd.h"
+#include "bench.h"
+#include "mcts.h"
+#include "session.h"
+#include "server.h"
 
 using namespace std;
 
-bigdumb::Board myboard;
-bool FORCE_MODE = false;
-
-bool is_file(char c){
-    return c>='a' && c<='h';
-}
-
-bool is_rank(char c){
-    return c>='1' && c<='8';
-}
-
-bool is_chess_move(string s){
-    return is_file(s[0]) && is_rank(s[1]) && is_file(s[2]) && is_rank(s[3]);
-}
-
-int main(){
-    freopen("debug.txt", "w", stderr);
-
-    do{
-        string s;
-        cin >> s;
-        cerr << "winboard: " << s << endl;
-        if((s.length()==4 || s.length()==5) && is_chess_move(s)){
-            cerr << s << " is a valid move" << endl;
-            freopen("debug.txt", "w", stderr);
-            myboard.move(s);
-            if(!FORCE_MODE) {
-                myboard.abmin(INT_MIN, INT_MAX, ROOT_DEPTH);
-            }
-        }
-        if(s=="xboard"){
-            cout << "feature myname=\"bigdumb\"\n";
-            cout << "feature done=1\n";
-            precomputeKing();
-            precomputeKnights();
-            precomputePawns();
-            precomputeSliding();
-            cout << "sent features. init bitboards ready" << endl;
+int main(int argc, char **argv){
+    // options can go anywhere; what's left picks the mode
+    vector<string> args;
+    for(int i=1; i<argc; i++){
+        string opt=argv[i];
+        if(opt=="-telemetry" && i+1<argc) TELEMETRY_FILE=argv[++i];
+        else if(opt=="-trace" && i+1<argc){
+            TRACE_FILE=argv[++i];
+#ifndef SEARCH_TRACE
+            cerr << "warning: built without -DSEARCH_TRACE, -trace does nothing\n";
+#endif
         }
-        if(s=="new"){
-            cerr << "setting up a new game..." << endl;
-            myboard=bigdumb::Board();
-        }
-        if(s=="force"){
-            FORCE_MODE = true;
-            cerr << "force mode enabled" << endl;
+        else if(opt=="-learn" && i+1<argc){
+            LEARN_FILE=argv[++i];
+            if(bigdumb::LEARN.open(LEARN_FILE)) bigdumb::LEARN.seed(bigdumb::TT);
+            else{
+                cerr << "error: " << LEARN_FILE << " is not a learning file, not learning\n";
+                LEARN_FILE="";
+            }
         }
-        if(s=="go"){
-            FORCE_MODE = false;
-            cerr << "force mode disabled" << endl;
-            cerr << "engine playing as ";
-            if(myboard.half_move%2==0) cerr <<"white"<<endl;
-            else cerr << "black" << endl;
-            // make a new move.
-            myboard.abmin(INT_MIN, INT_MAX,ROOT_DEPTH);
+        else if(opt=="-nnue" && i+1<argc){
+            USE_NNUE=bigdumb::NNUE.load(argv[++i]);
+            if(!USE_NNUE) cerr << "error: can't load network " << argv[i] << ", using the classic evaluation\n";
         }
-    }while(1);
+        else args.push_back(opt);
+    }
+    if(args.size()>1 && args[0]=="epd"){
+        // tal epd <file> [depth] [threads]
+        precomputeAll();
+        int depth = args.size()>2 ? atoi(args[2].c_str()) : ROOT_DEPTH;
+        int threads = args.size()>3 ? atoi(args[3].c_str()) : thread::hardware_concurrency();
+        bigdumb::run_epd(args[1], depth, threads);
+        return 0;
+    }
+    if(args.size()>0 && args[0]=="bench"){
+        // tal bench [depth]
+        precomputeAll();
+        bigdumb::run_bench(args.size()>1 ? atoi(args[1].c_str()) : BENCH_DEPTH);
+        return 0;
+    }
+    if(args.size()>0 && args[0]=="mcts"){
+        // tal mcts [playouts] [threads] [uct]
+        precomputeAll();
+        int threads = args.size()>2 ? atoi(args[2].c_str()) : thread::hardware_concurrency();
+        bigdumb::run_mcts_bench(args.size()>1 ? atoi(args[1].c_str()) : 2000, threads < 1 ? 1 : threads,
+                                args.size()>3 && args[3]=="uct" ? MCTS_UCT : MCTS_PUCT);
+        return 0;
+    }
+    if(args.size()>0 && args[0]=="server"){
+        // tal server [threads] [ms per move]
+        bigdumb::LOGGER.open("debug.txt");
+        int threads = args.size()>1 ? atoi(args[1].c_str()) : thread::hardware_concurrency();
+        bigdumb::Server server(cout, args.size()>2 ? atoi(args[2].c_str()) : 0);
+        server.run(cin, threads);
+        bigdumb::LOGGER.close();
+        return 0;
+    }
+    bigdumb::LOGGER.open("debug.txt");
+
+    // analysis answers from its own thread
+    mutex out_lock;
+    bigdumb::Session session([&](const string &line){
+        lock_guard<mutex> guard(out_lock);
+        cout << line << endl;
+    }, false);
+    string line;
+    while(getline(cin, line)){
+        if(!line.empty() && line[line.length()-1]=='\r') line.erase(line.length()-1);
+        if(!session.command(line)) break;
+    }
+    session.analysis.stop();
 
-    fclose(stderr);
+    bigdumb::LOGGER.close();
     return 0;
 }
@@ -0,0 +1,133 @@
+#ifndef _trace_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// a recording of the search tree behind one move. compiled in with
+// -DSEARCH_TRACE and switched on with `-trace <file>`; without the
+// define the TRACE() calls in the search are not compiled at all.
+//
+// the search writes fixed size records into a buffer allocated once,
+// and think() appends the whole buffer to the file after the move.
+// when the buffer fills up, later records are counted and dropped, so
+// a long search costs a bounded amount of memory and time.
+//
+// the file is a sequence of blocks, one per move, in the byte order of
+// the machine that wrote it:
+//
+//   TraceHeader, then header.count TraceRecords
+//
+// tracedump.cpp turns it into Chrome trace JSON or an indented tree.
+
+#define TRACE_MAGIC 0x52544442u
+#define TRACE_VERSION 1
+
+// a child searched (window in alpha/beta), its result (score), and
+// each iterative deepening pass (depth, then score and best move)
+#define TRACE_ENTER 1
+#define TRACE_EXIT 2
+#define TRACE_ITER_BEGIN 3
+#define TRACE_ITER_END 4
+
+std::string TRACE_FILE = "";
+// records per move, 24 bytes each
+int TRACE_RECORDS = 1<<20;
+
+namespace bigdumb{
+    class TraceRecord{
+        public:
+            uint8_t type;
+            uint8_t depth;
+            uint8_t from;
+            uint8_t to;
+            int32_t alpha;
+            int32_t beta;
+            int32_t score;
+            // since the start of the move
+            uint64_t ns;
+    };
+
+    class TraceHeader{
+        public:
+            uint32_t magic;
+            uint32_t version;
+            // half move the engine played at, and what it played
+            uint32_t ply;
+            uint8_t from;
+            uint8_t to;
+            uint16_t unused;
+            uint64_t count;
+            uint64_t dropped;
+    };
+
+    std::mutex TRACE_LOCK;
+
+    class Tracer{
+        public:
+            std::vector<TraceRecord> records;
+            size_t used;
+            uint64_t dropped;
+            std::chrono::steady_clock::time_point start;
+
+            Tracer(size_t capacity){
+                records.resize(capacity);
+                begin();
+            }
+
+            void begin(){
+                used=0;
+                dropped=0;
+                start=std::chrono::steady_clock::now();
+            }
+
+            void record(int type, int depth, int from, int to, int alpha, int beta, int score){
+                if(used==records.size()){
+                    dropped++;
+                    return;
+                }
+                TraceRecord &r=records[used++];
+                r.type=static_cast<uint8_t>(type);
+                r.depth=static_cast<uint8_t>(depth);
+                r.from=static_cast<uint8_t>(from);
+                r.to=static_cast<uint8_t>(to);
+                r.alpha=alpha;
+                r.beta=beta;
+                r.score=score;
+                r.ns=std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now()-start).count();
+            }
+
+            void flush(const std::string &file, int ply, int from, int to){
+                // other sessions may be writing their moves too
+                std::lock_guard<std::mutex> guard(TRACE_LOCK);
+                FILE *out=fopen(file.c_str(), "ab");
+                if(!out) return;
+                TraceHeader h;
+                h.magic=TRACE_MAGIC;
+                h.version=TRACE_VERSION;
+                h.ply=ply;
+                h.from=static_cast<uint8_t>(from);
+                h.to=static_cast<uint8_t>(to);
+                h.unused=0;
+                h.count=used;
+                h.dropped=dropped;
+                fwrite(&h, sizeof(h), 1, out);
+                if(used) fwrite(&records[0], sizeof(TraceRecord), used, out);
+                fclose(out);
+            }
+    };
+}
+
+#ifdef SEARCH_TRACE
+#define TRACE(ctx, type, depth, from, to, alpha, beta, score) \
+    if((ctx)->tracer) (ctx)->tracer->record(type, depth, from, to, alpha, beta, score)
+#else
+#define TRACE(ctx, type, depth, from, to, alpha, beta, score)
+#endif
+
+#define _trace_h
+#endif
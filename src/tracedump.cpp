@@ -0,0 +1,251 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+// reads the file a -DSEARCH_TRACE build writes with `-trace <file>`:
+//
+//   tracedump list <file>
+//   tracedump chrome <file> [move] > trace.json
+//   tracedump tree <file> <move> [depth] [iteration]
+//   tracedump explore <file> <move> [iteration]
+//
+// moves are numbered from 0 in the order they were played; `list`
+// shows them. chrome writes the Chrome trace event format (open it in
+// chrome://tracing or Perfetto), one row per move, with a span for
+// every iteration and every searched child. tree prints an iteration
+// (the last by default) as an indented tree, `depth` levels deep.
+// explore walks the same tree interactively: a number goes into that
+// child, `u` goes up, `q` quits.
+
+using namespace std;
+
+class Block{
+    public:
+        bigdumb::TraceHeader header;
+        vector<bigdumb::TraceRecord> records;
+};
+
+class Node{
+    public:
+        // a searched move, or an iteration when from is 64
+        int from, to, depth;
+        int alpha, beta, score;
+        // what an iteration picked
+        int best_from, best_to;
+        uint64_t start, end;
+        int parent;
+        vector<int> children;
+        // nodes below, this one included
+        long long size;
+};
+
+string square(int sq){
+    string s;
+    s+=static_cast<char>('a'+sq%8);
+    s+=static_cast<char>('8'-sq/8);
+    return s;
+}
+
+string bound(int x){
+    if(x==INT_MIN) return "-inf";
+    if(x==INT_MAX) return "inf";
+    ostringstream out;
+    out << x;
+    return out.str();
+}
+
+string name(const Node &n){
+    if(n.from==64){
+        ostringstream out;
+        out << "depth " << n.depth;
+        return out.str();
+    }
+    return square(n.from)+square(n.to);
+}
+
+bool load(const char *path, vector<Block> &blocks){
+    FILE *in=fopen(path, "rb");
+    if(!in){
+        cerr << "error: can't open " << path << "\n";
+        return false;
+    }
+    Block b;
+    while(fread(&b.header, sizeof(b.header), 1, in)==1){
+        if(b.header.magic!=TRACE_MAGIC || b.header.version!=TRACE_VERSION){
+            cerr << "error: " << path << " is not a trace, or from another version\n";
+            fclose(in);
+            return false;
+        }
+        b.records.resize(b.header.count);
+        if(b.header.count && fread(&b.records[0], sizeof(bigdumb::TraceRecord), b.header.count, in)!=b.header.count){
+            cerr << "warning: " << path << " ends in the middle of a move\n";
+            break;
+        }
+        blocks.push_back(b);
+    }
+    fclose(in);
+    return true;
+}
+
+vector<Node> build(const Block &b){
+    // nodes in the order they were entered; records past a full buffer
+    // are missing, so anything left open is closed at the last record
+    vector<Node> nodes;
+    vector<int> stack;
+    for(size_t i=0; i<b.records.size(); i++){
+        const bigdumb::TraceRecord &r=b.records[i];
+        if(r.type==TRACE_ENTER || r.type==TRACE_ITER_BEGIN){
+            Node n;
+            n.from=r.type==TRACE_ENTER ? r.from : 64;
+            n.to=r.to;
+            n.depth=r.depth;
+            n.alpha=r.alpha;
+            n.beta=r.beta;
+            n.score=0;
+            n.best_from=n.best_to=0;
+            n.start=n.end=r.ns;
+            n.parent=stack.empty() ? -1 : stack.back();
+            n.size=1;
+            if(n.parent>=0) nodes[n.parent].children.push_back(nodes.size());
+            stack.push_back(nodes.size());
+            nodes.push_back(n);
+        }
+        else if(!stack.empty()){
+            Node &n=nodes[stack.back()];
+            n.score=r.score;
+            n.end=r.ns;
+            if(r.type==TRACE_ITER_END){
+                n.best_from=r.from;
+                n.best_to=r.to;
+            }
+            stack.pop_back();
+        }
+    }
+    uint64_t last=b.records.empty() ? 0 : b.records.back().ns;
+    for(size_t i=0; i<stack.size(); i++) nodes[stack[i]].end=last;
+    for(int i=static_cast<int>(nodes.size())-1; i>=0; i--){
+        if(nodes[i].parent>=0) nodes[nodes[i].parent].size+=nodes[i].size;
+    }
+    return nodes;
+}
+
+string describe(const Node &n){
+    ostringstream out;
+    out << name(n);
+    if(n.from==64) out << " -> " << bound(n.score) << " best " << square(n.best_from) << square(n.best_to);
+    else out << " d" << n.depth << " [" << bound(n.alpha) << ", " << bound(n.beta) << "] -> " << bound(n.score);
+    out << "  (" << n.size << " nodes, " << (n.end-n.start)/1000 << " us)";
+    return out.str();
+}
+
+int iteration(const vector<Node> &nodes, int wanted){
+    // the root of the wanted depth, or of the last iteration
+    int found=-1;
+    for(size_t i=0; i<nodes.size(); i++){
+        if(nodes[i].parent>=0) continue;
+        if(wanted<=0 || nodes[i].depth==wanted) found=i;
+    }
+    return found;
+}
+
+void print_tree(const vector<Node> &nodes, int n, int level, int max_level){
+    cout << string(2*level, ' ') << describe(nodes[n]) << "\n";
+    if(level>=max_level) return;
+    for(size_t c=0; c<nodes[n].children.size(); c++) print_tree(nodes, nodes[n].children[c], level+1, max_level);
+}
+
+void chrome(const vector<Block> &blocks, int only){
+    cout << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first=true;
+    for(size_t m=0; m<blocks.size(); m++){
+        if(only>=0 && static_cast<int>(m)!=only) continue;
+        const Block &b=blocks[m];
+        cout << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << m
+             << ",\"args\":{\"name\":\"move " << m << ": ply " << b.header.ply << " "
+             << square(b.header.from) << square(b.header.to) << "\"}}";
+        first=false;
+        vector<Node> nodes=build(b);
+        for(size_t i=0; i<nodes.size(); i++){
+            const Node &n=nodes[i];
+            cout << ",\n{\"name\":\"" << name(n) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << m
+                 << ",\"ts\":" << n.start/1000.0 << ",\"dur\":" << (n.end-n.start)/1000.0
+                 << ",\"args\":{\"depth\":" << n.depth << ",\"alpha\":\"" << bound(n.alpha)
+                 << "\",\"beta\":\"" << bound(n.beta) << "\",\"score\":\"" << bound(n.score)
+                 << "\",\"nodes\":" << n.size << "}}";
+        }
+    }
+    cout << "\n]}\n";
+}
+
+void explore(const vector<Node> &nodes, int root){
+    int at=root;
+    string line;
+    while(true){
+        cout << describe(nodes[at]) << "\n";
+        for(size_t c=0; c<nodes[at].children.size(); c++){
+            cout << "  " << c << ": " << describe(nodes[nodes[at].children[c]]) << "\n";
+        }
+        cout << "> " << flush;
+        if(!getline(cin, line) || line=="q") return;
+        if(line=="u"){
+            if(nodes[at].parent>=0) at=nodes[at].parent;
+        }
+        else if(!line.empty()){
+            size_t c=atoi(line.c_str());
+            if(c<nodes[at].children.size()) at=nodes[at].children[c];
+        }
+    }
+}
+
+int main(int argc, char **argv){
+    if(argc<3){
+        cerr << "usage: tracedump list|chrome|tree|explore <file> ...\n";
+        return 1;
+    }
+    string cmd=argv[1];
+    vector<Block> blocks;
+    if(!load(argv[2], blocks)) return 1;
+    if(cmd=="list"){
+        for(size_t m=0; m<blocks.size(); m++){
+            const Block &b=blocks[m];
+            vector<Node> nodes=build(b);
+            cout << m << ": ply " << b.header.ply << " " << square(b.header.from) << square(b.header.to)
+                 << ", " << b.header.count << " records";
+            if(b.header.dropped) cout << " (" << b.header.dropped << " dropped)";
+            cout << ", " << (b.records.empty() ? 0 : b.records.back().ns/1000000) << " ms\n";
+            for(size_t i=0; i<nodes.size(); i++){
+                if(nodes[i].parent<0) cout << "    " << describe(nodes[i]) << "\n";
+            }
+        }
+        return 0;
+    }
+    if(cmd=="chrome"){
+        chrome(blocks, argc>3 ? atoi(argv[3]) : -1);
+        return 0;
+    }
+    if((cmd=="tree" || cmd=="explore") && argc>3){
+        int m=atoi(argv[3]);
+        if(m<0 || m>=static_cast<int>(blocks.size())){
+            cerr << "error: no move " << m << ", the file has " << blocks.size() << "\n";
+            return 1;
+        }
+        vector<Node> nodes=build(blocks[m]);
+        int wanted=cmd=="tree" ? (argc>5 ? atoi(argv[5]) : 0) : (argc>4 ? atoi(argv[4]) : 0);
+        int root=iteration(nodes, wanted);
+        if(root<0){
+            cerr << "error: no such iteration\n";
+            return 1;
+        }
+        if(cmd=="tree") print_tree(nodes, root, 0, argc>4 ? atoi(argv[4]) : 2);
+        else explore(nodes, root);
+        return 0;
+    }
+    cerr << "unknown command " << cmd << "\n";
+    return 1;
+}
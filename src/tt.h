@@ -0,0 +1,80 @@
+#ifndef _tt_h
+
+#include <stdint.h>
+#include <vector>
+
+// default size of the transposition table in megabytes; xboard's
+// `memory` command changes it.
+int TT_MB = 16;
+
+#define TT_EXACT 1
+#define TT_LOWER 2
+#define TT_UPPER 3
+
+namespace bigdumb{
+    class TTEntry{
+        public:
+            int score;
+            int depth;
+            int flag;
+            int from;
+            int to;
+    };
+
+    // one slot per position, shared by every thread that searches. a
+    // slot is two words, the key stored xored with the data, so a slot
+    // torn by two threads writing at once just fails to match instead
+    // of handing back another position's score.
+    class TranspositionTable{
+        public:
+            std::vector<uint64_t> slots;
+            size_t mask;
+
+            TranspositionTable(){
+                resize(TT_MB);
+            }
+
+            void resize(int mb){
+                // a power of two number of 16 byte slots
+                size_t n=1;
+                while(n*2*16<=static_cast<size_t>(mb)*1024*1024) n*=2;
+                slots.assign(2*n, 0);
+                mask=n-1;
+            }
+
+            void clear(){
+                for(size_t i=0; i<slots.size(); i++) slots[i]=0;
+            }
+
+            bool probe(unsigned long long key, TTEntry &e){
+                size_t i=2*(key&mask);
+                uint64_t data=slots[i+1];
+                if((slots[i]^data)!=key || data==0) return false;
+                e.score=static_cast<int32_t>(data&0xFFFFFFFF);
+                e.depth=(data>>32)&0xFF;
+                e.flag=(data>>40)&3;
+                e.from=(data>>42)&63;
+                e.to=(data>>48)&63;
+                return true;
+            }
+
+            void store(unsigned long long key, int score, int depth, int flag, int from, int to){
+                size_t i=2*(key&mask);
+                // keep a deeper result for the same position
+                uint64_t old=slots[i+1];
+                if((slots[i]^old)==key && old!=0 && static_cast<int>((old>>32)&0xFF)>depth) return;
+                uint64_t data=static_cast<uint32_t>(score)
+                    | static_cast<uint64_t>(depth&0xFF)<<32
+                    | static_cast<uint64_t>(flag)<<40
+                    | static_cast<uint64_t>(from&63)<<42
+                    | static_cast<uint64_t>(to&63)<<48;
+                slots[i]=key^data;
+                slots[i+1]=data;
+            }
+    };
+
+    TranspositionTable TT;
+}
+
+#define _tt_h
+#endif
@@ -0,0 +1,269 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <list>
+#include <string>
+#include "debug.h"
+#include "movestore.h"
+#include "board.h"
+#include "pgn.h"
+
+// texel tuning of the material values and piece square tables:
+//
+//   tune [-threads N] [-epochs N] [-rate x] [-out file] games.pgn ...
+//
+// the evaluation is linear in its weights, so each quiet position is
+// stored once as a short list of (weight, +1/-1) features and the whole
+// set is scored with a few gathers per position. the output has the
+// same layout as psq.h and can replace it as is.
+
+using namespace std;
+
+#define PIECE_TYPES 6
+// 5 material values (the king's is fixed) then 6 tables of 64
+#define WEIGHTS (5 + PIECE_TYPES*64)
+#define SKIP_PLIES 16
+#define BATCH 256
+
+const char *PIECE_NAMES[PIECE_TYPES] = {"PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING"};
+
+class Dataset{
+    public:
+        // features of position i are index/sign[offset[i] .. offset[i+1])
+        vector<uint16_t> index;
+        vector<int8_t> sign;
+        vector<uint32_t> offset;
+        vector<float> result;
+
+        Dataset(){
+            offset.push_back(0);
+        }
+
+        size_t size() const { return result.size(); }
+};
+
+int piece_type(char p){
+    switch(toupper(p)){
+        case 'P': return 0; case 'N': return 1; case 'B': return 2;
+        case 'R': return 3; case 'Q': return 4; case 'K': return 5;
+    }
+    return -1;
+}
+
+void add_position(Dataset &data, bigdumb::Board &board, float result){
+    for(int i=0; i<8; i++){
+        for(int j=0; j<8; j++){
+            char p=board.a[i][j];
+            int t=piece_type(p);
+            if(t<0) continue;
+            bool white=board.is_white(p);
+            // same indexing as board_white_value()/board_black_value()
+            int sq=white ? 8*i+j : 8*(7-i)+j;
+            int8_t s=white ? 1 : -1;
+            if(t<5){
+                data.index.push_back(t);
+                data.sign.push_back(s);
+            }
+            data.index.push_back(5+64*t+sq);
+            data.sign.push_back(s);
+        }
+    }
+    data.offset.push_back(data.index.size());
+    data.result.push_back(result);
+}
+
+bool quiet(bigdumb::Board &board){
+    // no captures to make and not in check: the static evaluation
+    // is what a quiescence search would return anyway
+    bool white=board.half_move%2==0;
+    if(board.in_check(white)) return false;
+    bigdumb::Board temp_board=board;
+    temp_board.gen_moves();
+    return temp_board.capture.empty();
+}
+
+void extract(string file, Dataset &data, long long &games){
+    ifstream in(file.c_str());
+    if(!in){
+        cerr << "error: can't open " << file << "\n";
+        return;
+    }
+    bigdumb::PgnGame game;
+    while(bigdumb::read_pgn_game(in, game)){
+        float result;
+        if(game.result=="1-0") result=1;
+        else if(game.result=="0-1") result=0;
+        else if(game.result=="1/2-1/2") result=0.5;
+        else continue;
+        bigdumb::Board board;
+        if(!board.set_fen(game.start_fen())) continue;
+        games++;
+        for(size_t m=0; m<game.moves.size(); m++){
+            if(static_cast<int>(m)>=SKIP_PLIES && quiet(board)) add_position(data, board, result);
+            string coord;
+            if(!bigdumb::resolve_san(board, game.moves[m], coord)) break;
+            board.move(coord);
+        }
+    }
+}
+
+void initial_weights(vector<double> &w){
+    w.assign(WEIGHTS, 0);
+    w[0]=PAWN_VALUE; w[1]=KNIGHT_VALUE; w[2]=BISHOP_VALUE; w[3]=ROOK_VALUE; w[4]=QUEEN_VALUE;
+    int *tables[PIECE_TYPES]={PAWN_PSQ, KNIGHT_PSQ, BISHOP_PSQ, ROOK_PSQ, QUEEN_PSQ, KING_PSQ};
+    for(int t=0; t<PIECE_TYPES; t++)
+        for(int sq=0; sq<64; sq++) w[5+64*t+sq]=tables[t][sq];
+}
+
+// squared error over [begin, end), and its gradient added into grad
+// when grad is given. evals are gathered a batch at a time so the
+// sigmoid and error arithmetic runs over plain arrays.
+double error_range(const Dataset &data, const vector<double> &w, double k,
+                   size_t begin, size_t end, vector<double> *grad){
+    double error=0;
+    double eval[BATCH], delta[BATCH];
+    for(size_t base=begin; base<end; base+=BATCH){
+        size_t n=min(static_cast<size_t>(BATCH), end-base);
+        for(size_t i=0; i<n; i++){
+            double e=0;
+            for(uint32_t f=data.offset[base+i]; f<data.offset[base+i+1]; f++)
+                e+=data.sign[f]*w[data.index[f]];
+            eval[i]=e;
+        }
+        for(size_t i=0; i<n; i++){
+            double s=1/(1+exp(-k*eval[i]*(M_LN10/400)));
+            double r=data.result[base+i]-s;
+            error+=r*r;
+            delta[i]=-2*r*s*(1-s)*k*(M_LN10/400);
+        }
+        if(!grad) continue;
+        for(size_t i=0; i<n; i++){
+            for(uint32_t f=data.offset[base+i]; f<data.offset[base+i+1]; f++)
+                (*grad)[data.index[f]]+=delta[i]*data.sign[f];
+        }
+    }
+    return error;
+}
+
+double total_error(const Dataset &data, const vector<double> &w, double k,
+                   int threads, vector<double> *grad){
+    vector<double> errors(threads, 0);
+    vector<vector<double> > grads(threads, vector<double>(WEIGHTS, 0));
+    vector<thread> pool;
+    size_t chunk=(data.size()+threads-1)/threads;
+    for(int t=0; t<threads; t++){
+        pool.push_back(thread([&, t](){
+            size_t begin=min(data.size(), t*chunk), end=min(data.size(), begin+chunk);
+            errors[t]=error_range(data, w, k, begin, end, grad ? &grads[t] : NULL);
+        }));
+    }
+    double error=0;
+    for(int t=0; t<threads; t++){
+        pool[t].join();
+        error+=errors[t];
+        if(grad) for(int i=0; i<WEIGHTS; i++) (*grad)[i]+=grads[t][i];
+    }
+    return error/data.size();
+}
+
+double fit_k(const Dataset &data, const vector<double> &w, int threads){
+    // golden section search for the scaling that best fits the
+    // starting weights
+    double lo=0.1, hi=3, g=(sqrt(5.0)-1)/2;
+    double a=hi-g*(hi-lo), b=lo+g*(hi-lo);
+    double ea=total_error(data, w, a, threads, NULL), eb=total_error(data, w, b, threads, NULL);
+    for(int i=0; i<30; i++){
+        if(ea<eb){
+            hi=b; b=a; eb=ea;
+            a=hi-g*(hi-lo);
+            ea=total_error(data, w, a, threads, NULL);
+        }
+        else{
+            lo=a; a=b; ea=eb;
+            b=lo+g*(hi-lo);
+            eb=total_error(data, w, b, threads, NULL);
+        }
+    }
+    return (lo+hi)/2;
+}
+
+void write_header(string file, const vector<double> &w){
+    ofstream out(file.c_str());
+    out << "\n// generated by tune.cpp\n\n";
+    for(int t=0; t<5; t++)
+        out << "int " << PIECE_NAMES[t] << "_VALUE = " << static_cast<int>(floor(w[t]+0.5)) << ";\n";
+    out << "int KING_VALUE = " << KING_VALUE << ";\n";
+    for(int t=0; t<PIECE_TYPES; t++){
+        out << "\nint " << PIECE_NAMES[t] << "_PSQ[64]\n={\n";
+        for(int sq=0; sq<64; sq++){
+            char cell[8];
+            snprintf(cell, sizeof(cell), "%3d", static_cast<int>(floor(w[5+64*t+sq]+0.5)));
+            out << cell << (sq==63 ? "\n" : ((sq&7)==7 ? ",\n" : ","));
+        }
+        out << "};\n";
+    }
+}
+
+int main(int argc, char **argv){
+    int threads=thread::hardware_concurrency(), epochs=500;
+    double rate=1;
+    string out="psq_tuned.h";
+    vector<string> files;
+    for(int i=1; i<argc; i++){
+        string opt=argv[i];
+        if(opt=="-threads" && i+1<argc) threads=atoi(argv[++i]);
+        else if(opt=="-epochs" && i+1<argc) epochs=atoi(argv[++i]);
+        else if(opt=="-rate" && i+1<argc) rate=atof(argv[++i]);
+        else if(opt=="-out" && i+1<argc) out=argv[++i];
+        else files.push_back(opt);
+    }
+    if(threads<1) threads=1;
+    if(files.empty()){
+        cerr << "usage: tune [-threads N] [-epochs N] [-rate x] [-out file] games.pgn ...\n";
+        return 1;
+    }
+    precomputeAll();
+
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    Dataset data;
+    long long games=0;
+    for(size_t i=0; i<files.size(); i++) extract(files[i], data, games);
+    double extracted=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    cout << data.size() << " quiet positions from " << games << " games in " << extracted << "s" << endl;
+    if(data.size()==0) return 1;
+
+    vector<double> w;
+    initial_weights(w);
+    double k=fit_k(data, w, threads);
+    cout << "K = " << k << ", starting error " << total_error(data, w, k, threads, NULL) << endl;
+
+    // adam keeps one step size working for material values and
+    // table entries alike
+    vector<double> m(WEIGHTS, 0), v(WEIGHTS, 0);
+    const double b1=0.9, b2=0.999;
+    for(int epoch=1; epoch<=epochs; epoch++){
+        vector<double> grad(WEIGHTS, 0);
+        double error=total_error(data, w, k, threads, &grad);
+        for(int i=0; i<WEIGHTS; i++){
+            double g=grad[i]/data.size();
+            m[i]=b1*m[i]+(1-b1)*g;
+            v[i]=b2*v[i]+(1-b2)*g*g;
+            double mh=m[i]/(1-pow(b1, epoch)), vh=v[i]/(1-pow(b2, epoch));
+            w[i]-=rate*mh/(sqrt(vh)+1e-8);
+        }
+        if(epoch%50==0 || epoch==epochs){
+            double elapsed=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+            cout << "epoch " << epoch << " error " << error << " (" << elapsed << "s)" << endl;
+        }
+    }
+    write_header(out, w);
+    cout << "wrote " << out << endl;
+    return 0;
+}